@@ -1,282 +1,885 @@
 #include "HuffmanCoding.hpp"
+#include "../common/mapped_file.h"
+#include "../common/thread_pool.h"
+#include "../common/ordered_pipeline.h"
+#include <algorithm>
 #include <fstream>
 #include <iostream>
-#include <bitset>
-#include <mutex>
-#include <thread>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <sys/stat.h>
+
+namespace {
+// Spelled out byte by byte so that compilers turn them into a single load
+// or store and a byte swap.
+inline uint64_t loadBigEndian64(const uint8_t* p) {
+    return (uint64_t(p[0]) << 56) | (uint64_t(p[1]) << 48) | (uint64_t(p[2]) << 40) | (uint64_t(p[3]) << 32) |
+           (uint64_t(p[4]) << 24) | (uint64_t(p[5]) << 16) | (uint64_t(p[6]) << 8) | uint64_t(p[7]);
+}
 
-std::mutex freqMutex;
+inline void storeBigEndian64(uint8_t* p, uint64_t v) {
+    p[0] = static_cast<uint8_t>(v >> 56);
+    p[1] = static_cast<uint8_t>(v >> 48);
+    p[2] = static_cast<uint8_t>(v >> 40);
+    p[3] = static_cast<uint8_t>(v >> 32);
+    p[4] = static_cast<uint8_t>(v >> 24);
+    p[5] = static_cast<uint8_t>(v >> 16);
+    p[6] = static_cast<uint8_t>(v >> 8);
+    p[7] = static_cast<uint8_t>(v);
+}
 
-// ---------- Constructor / Destructor ----------
+inline uint32_t readU32(const uint8_t* p) {
+    return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
 
-HuffmanCoding::HuffmanCoding() : root(nullptr) {}
+inline void writeU32(uint8_t* p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = static_cast<uint8_t>(v >> (8 * i));
+}
 
-HuffmanCoding::~HuffmanCoding() {
-    freeTree(root);
+std::istream& openInput(const std::string& path, std::ifstream& file) {
+    if (path == "-") return std::cin;
+    file.open(path, std::ios::binary);
+    if (!file) throw std::runtime_error("Cannot open file : " + path);
+    return file;
 }
 
-void HuffmanCoding::freeTree(Node* node) {
-    if (!node) return;
-    freeTree(node->left);
-    freeTree(node->right);
-    delete node;
+std::ostream& openOutput(const std::string& path, std::ofstream& file) {
+    if (path == "-") return std::cout;
+    file.open(path, std::ios::binary);
+    if (!file) throw std::runtime_error("Cannot open file: " + path);
+    return file;
 }
 
-// ---------- Build Frequency Table (Multithreaded) ----------
+bool isRegularFile(const std::string& path) {
+    struct stat st;
+    return path != "-" && ::stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode);
+}
 
-void HuffmanCoding::buildFrequencyTable(const std::string& text) {
-    freqTable.clear();
+// Reads up to size bytes; fewer only at the end of the input.
+void readChunk(std::istream& in, std::vector<uint8_t>& buf, size_t size) {
+    buf.resize(size);
+    in.read(reinterpret_cast<char*>(buf.data()), size);
+    buf.resize(in.gcount());
+    if (in.bad()) throw std::runtime_error("Failed to read input.");
+}
+
+// Appends exactly n bytes from in to buf.
+void appendExact(std::istream& in, std::vector<uint8_t>& buf, size_t n) {
+    size_t old = buf.size();
+    buf.resize(old + n);
+    if (!in.read(reinterpret_cast<char*>(buf.data() + old), n)) throw std::runtime_error("Encoded data ended early");
+}
 
-    int numThreads = std::thread::hardware_concurrency();
-    if (numThreads == 0) numThreads = 4;
+void writeBytes(std::ostream& out, const uint8_t* data, size_t n) {
+    if (!out.write(reinterpret_cast<const char*>(data), n)) throw std::runtime_error("Failed to write output.");
+}
+}
+
+// ---------- Constructor / Destructor ----------
 
-    int chunkSize = text.size() / numThreads;
-    std::vector<std::thread> threads;
+HuffmanCoding::HuffmanCoding(size_t threads) : threads(threads) {}
 
-    auto worker = [&](int start, int end) {
-        std::unordered_map<char, int> localFreq;
-        for (int i = start; i < end; i++) {
-            localFreq[text[i]]++;
+// ---------- Build Frequency Table (Multithreaded) ----------
+
+// Each slice is counted into four interleaved tables, so runs of the same
+// byte do not wait on the store to the counter they just incremented, and
+// summed into its own slot; the slots are added up at the end, so no lock is
+// taken. The slices run on the caller's pool (the one that later codes the
+// blocks) plus the calling thread; without a pool, or for slices under
+// MIN_SLICE, the caller counts everything itself.
+void HuffmanCoding::buildFrequencyTable(const uint8_t* text, size_t size, ThreadPool* pool) {
+    constexpr size_t MIN_SLICE = 1 << 20;
+    size_t slices = pool ? std::max<size_t>(1, std::min(pool->size() + 1, size / MIN_SLICE)) : 1;
+    size_t sliceSize = size / slices;
+
+    std::vector<std::array<uint64_t, 256>> partial(slices);
+    auto worker = [&](size_t t) {
+        size_t start = t * sliceSize;
+        size_t end = (t == slices - 1) ? size : start + sliceSize;
+        uint64_t counts[4][256] = {};
+        size_t i = start;
+        for (; i + 4 <= end; i += 4) {
+            counts[0][text[i]]++;
+            counts[1][text[i + 1]]++;
+            counts[2][text[i + 2]]++;
+            counts[3][text[i + 3]]++;
         }
-        std::lock_guard<std::mutex> lock(freqMutex);
-        for (auto& p : localFreq) freqTable[p.first] += p.second;
+        for (; i < end; i++) counts[0][text[i]]++;
+        for (int s = 0; s < 256; s++) partial[t][s] = counts[0][s] + counts[1][s] + counts[2][s] + counts[3][s];
     };
 
-    for (int i = 0; i < numThreads; i++) {
-        int start = i * chunkSize;
-        int end = (i == numThreads - 1) ? text.size() : start + chunkSize;
-        threads.emplace_back(worker, start, end);
-    }
+    std::vector<std::future<void>> pending;
+    for (size_t t = 1; t < slices; t++) pending.push_back(pool->submit([&worker, t] { worker(t); }));
+    worker(0);
+    for (auto& p : pending) p.get();
 
-    for (auto& t : threads) t.join();
+    freqTable.fill(0);
+    for (const auto& counts : partial)
+        for (int s = 0; s < 256; s++) freqTable[s] += counts[s];
 }
 
 // ---------- Build Huffman Tree ----------
 
+// Two-queue construction: the sorted leaves form one queue and the merged
+// nodes, whose weights only grow, form the other, so the two lightest nodes
+// are always at the queue fronts and no heap or allocation is needed.
 void HuffmanCoding::buildTree() {
-    std::priority_queue<Node*, std::vector<Node*>, Compare> pq;
-    for (auto& pair : freqTable) {
-        pq.push(new Node(pair.first, pair.second));
+    leafCount = 0;
+    for (int s = 0; s < 256; s++) {
+        if (freqTable[s]) nodes[leafCount++] = {freqTable[s], 0, static_cast<uint8_t>(s)};
     }
-
-    while (pq.size() > 1) {
-        Node* left = pq.top(); pq.pop();
-        Node* right = pq.top(); pq.pop();
-
-        Node* parent = new Node('$', left->freq + right->freq);
-        parent->left = left;
-        parent->right = right;
-        pq.push(parent);
+    std::sort(nodes.begin(), nodes.begin() + leafCount, [](const Node& a, const Node& b) {
+        return a.freq != b.freq ? a.freq < b.freq : a.symbol < b.symbol;
+    });
+    if (leafCount < 2) return;
+
+    size_t leaf = 0, merged = leafCount, next = leafCount;
+    auto lightest = [&]() {
+        if (leaf < leafCount && (merged == next || nodes[leaf].freq <= nodes[merged].freq)) return leaf++;
+        return merged++;
+    };
+    for (; next < 2 * leafCount - 1; next++) {
+        size_t a = lightest();
+        size_t b = lightest();
+        nodes[next] = {nodes[a].freq + nodes[b].freq, 0, 0};
+        nodes[a].parent = nodes[b].parent = static_cast<uint16_t>(next);
     }
-
-    root = pq.empty() ? nullptr : pq.top();
 }
 
-// ---------- Generate Huffman Codes ----------
+// ---------- Code Lengths ----------
 
-void HuffmanCoding::generateCodes(Node* node, const std::string& code) {
-    if (!node) return;
+// A leaf's code length is its depth. Parents follow their children in the
+// array, so one pass down from the root sets every depth from the parent's.
+void HuffmanCoding::treeDepths(uint8_t* depths) const {
+    if (leafCount == 0) return;
+    size_t rootIndex = 2 * leafCount - 2;
+    depths[rootIndex] = 0;
+    for (size_t i = rootIndex; i-- > 0;) depths[i] = depths[nodes[i].parent] + 1;
+}
+
+// ---------- Encode ----------
 
-    if (node->isLeaf()) {
-        huffmanCodes[node->ch] = code.empty() ? "0" : code; // Edge case: single char
+// Huffman's optimal lengths can exceed MAX_CODE_LENGTH on skewed inputs.
+// Longer codes are clamped, the Kraft sum is brought back to one by moving
+// leaves down from the deepest shorter level (as deflate encoders do), and
+// the lengths are then handed out again in frequency order.
+void HuffmanCoding::limitCodeLengths(uint8_t* lengths) const {
+    std::fill(lengths, lengths + 256, 0);
+    if (leafCount == 1) {
+        lengths[nodes[0].symbol] = 1;
         return;
     }
+    uint8_t depths[MAX_NODES];
+    treeDepths(depths);
+    unsigned count[MAX_CODE_LENGTH + 1] = {};
+    for (size_t i = 0; i < leafCount; i++) count[std::min<unsigned>(depths[i], MAX_CODE_LENGTH)]++;
+
+    uint32_t total = 0;
+    for (unsigned len = 1; len <= MAX_CODE_LENGTH; len++) total += count[len] << (MAX_CODE_LENGTH - len);
+    while (total > (1u << MAX_CODE_LENGTH)) {
+        count[MAX_CODE_LENGTH]--;
+        for (unsigned len = MAX_CODE_LENGTH - 1; len > 0; len--) {
+            if (count[len]) {
+                count[len]--;
+                count[len + 1] += 2;
+                break;
+            }
+        }
+        total--;
+    }
 
-    generateCodes(node->left, code + "0");
-    generateCodes(node->right, code + "1");
+    // The leaves are sorted lightest first, so the shortest lengths go to
+    // the end of the array.
+    size_t k = leafCount;
+    for (unsigned len = 1; len <= MAX_CODE_LENGTH; len++)
+        for (unsigned c = 0; c < count[len]; c++) lengths[nodes[--k].symbol] = static_cast<uint8_t>(len);
 }
 
-// ---------- Encode ----------
-
-std::string HuffmanCoding::getHeader() {
-    std::string headerStr;
-    for (const auto& pair : huffmanCodes) {
-        headerStr += pair.first;         // store character
-        headerStr += '|';                // separator before code
-        headerStr += pair.second;        // store its code
-        headerStr += '`';                // separator after code
+// Deflate's canonical assignment: codes of each length are consecutive,
+// ordered by symbol, and follow on from the last code of the length below.
+void HuffmanCoding::canonicalCodes(const uint8_t* lengths, std::vector<Code>& codes) {
+    unsigned count[MAX_CODE_LENGTH + 1] = {};
+    for (int s = 0; s < 256; s++) count[lengths[s]]++;
+    count[0] = 0;
+    uint64_t next[MAX_CODE_LENGTH + 1] = {};
+    uint64_t code = 0;
+    for (unsigned len = 1; len <= MAX_CODE_LENGTH; len++) {
+        code = (code + count[len - 1]) << 1;
+        next[len] = code;
     }
-    headerStr += "~~"; // marks end of header
-    return headerStr;
+    codes.clear();
+    for (int s = 0; s < 256; s++)
+        if (lengths[s]) codes.push_back({static_cast<uint8_t>(s), lengths[s], next[lengths[s]]++});
 }
 
-int HuffmanCoding::encode(const std::string& fileName) {
-    std::ifstream in(fileName);
-    if (!in) {
-        std::cerr << "Failed to open input file: " << fileName << std::endl;
-        return 1;
+std::string HuffmanCoding::getHeader(const uint8_t* lengths, unsigned long long symbolCount) {
+    std::string header(reinterpret_cast<const char*>(MAGIC), sizeof(MAGIC));
+    for (int i = 0; i < 8; i++) header += static_cast<char>(symbolCount >> (8 * i));
+    header += static_cast<char>(BLOCK_LOG);
+    int highest = 255;
+    while (highest > 0 && lengths[highest] == 0) highest--;
+    header += static_cast<char>(highest);
+    for (int s = 0; s <= highest; s += 2)
+        header += static_cast<char>(lengths[s] | ((s + 1 <= highest ? lengths[s + 1] : 0) << 4));
+    return header;
+}
+
+size_t HuffmanCoding::compressBound(size_t srcSize) {
+    // A block that would not shrink is stored raw, so each one costs at most
+    // BLOCK_OVERHEAD bytes on top of its input.
+    size_t blocks = (srcSize + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    return HEADER_BOUND + blocks * BLOCK_OVERHEAD + srcSize;
+}
+
+// Codes are appended to the low end of a 64-bit accumulator, which never
+// holds more than 7 bits between flushes. Three codes of at most 15 bits fit
+// on top of those, and a flush stores all 8 bytes at once and advances past
+// the whole ones, so the main loop has no per-bit or per-byte work. Returns
+// the stream's size, or SIZE_MAX if it does not fit in capacity bytes.
+size_t HuffmanCoding::encodeStream(const EncodeEntry* table, const uint8_t* src, size_t n, uint8_t* dst, size_t capacity) {
+    uint8_t* out = dst;
+    uint8_t* const end = dst + capacity;
+    uint64_t acc = 0;
+    unsigned accBits = 0;
+    size_t i = 0;
+    if (capacity >= 8) {
+        const uint8_t* fastEnd = end - 8;
+        for (; i + 3 <= n && out <= fastEnd; i += 3) {
+            const EncodeEntry a = table[src[i]];
+            const EncodeEntry b = table[src[i + 1]];
+            const EncodeEntry c = table[src[i + 2]];
+            // Joining the three codes first keeps them off the accumulator's
+            // dependency chain.
+            uint64_t group = (((uint64_t(a.bits) << b.length) | b.bits) << c.length) | c.bits;
+            unsigned groupBits = a.length + b.length + c.length;
+            acc = (acc << groupBits) | group;
+            accBits += groupBits;
+            storeBigEndian64(out, acc << (64 - accBits));
+            out += accBits >> 3;
+            accBits &= 7;
+        }
+    }
+    for (; i < n; i++) {
+        const EncodeEntry e = table[src[i]];
+        acc = (acc << e.length) | e.bits;
+        accBits += e.length;
+        while (accBits >= 8) {
+            if (out == end) return SIZE_MAX;
+            accBits -= 8;
+            *out++ = static_cast<uint8_t>(acc >> accBits);
+        }
     }
 
-    std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
-    in.close();
+    // The symbol count marks the end, so the last byte is simply zero-filled.
+    if (accBits > 0) {
+        if (out == end) return SIZE_MAX;
+        *out++ = static_cast<uint8_t>(acc << (8 - accBits));
+    }
+    return out - dst;
+}
 
-    buildFrequencyTable(content);
+// Writes one block of n bytes to dst, which must hold BLOCK_OVERHEAD + n
+// bytes, and returns its size. The four streams cover consecutive quarters
+// of the block; a block that would not come out smaller than its input is
+// stored raw instead.
+size_t HuffmanCoding::encodeBlock(const EncodeEntry* table, const uint8_t* src, size_t n, uint8_t* dst) {
+    size_t quarter = (n + 3) / 4;
+    uint8_t* out = dst + BLOCK_OVERHEAD;
+    uint8_t* const limit = dst + 4 + n;
+    for (int k = 0; k < 4 && out <= limit; k++) {
+        size_t start = std::min(n, k * quarter);
+        size_t written = encodeStream(table, src + start, std::min(quarter, n - start), out, limit - out);
+        if (written == SIZE_MAX) break;
+        if (k < 3) writeU32(dst + 4 + 4 * k, static_cast<uint32_t>(written));
+        out += written;
+        if (k == 3) {
+            writeU32(dst, static_cast<uint32_t>(out - dst - 4));
+            return out - dst;
+        }
+    }
+    writeU32(dst, static_cast<uint32_t>(n) | RAW_BLOCK);
+    std::memcpy(dst + 4, src, n);
+    return 4 + n;
+}
+
+// Turns freqTable into code lengths and fills encodeTable.
+void HuffmanCoding::buildEncodeTable(uint8_t* lengths) {
     buildTree();
-    generateCodes(root, "");
+    limitCodeLengths(lengths);
+    std::vector<Code> codes;
+    canonicalCodes(lengths, codes);
+    std::fill(encodeTable, encodeTable + 256, EncodeEntry{0, 0});
+    for (const Code& c : codes) encodeTable[c.symbol] = {static_cast<uint32_t>(c.bits), c.length};
+}
 
-    std::ofstream outputFile("output.txt", std::ios::binary);
-    if (!outputFile) {
-        std::cerr << "Failed to open output file.\n";
-        return 1;
+// Encodes the blocks of one file chunk back to back, each preceded by its
+// input size if prefixSizes is set. dst must hold n bytes plus 4 +
+// BLOCK_OVERHEAD per block.
+size_t HuffmanCoding::encodeChunk(const EncodeEntry* table, const uint8_t* src, size_t n, bool prefixSizes, uint8_t* dst) {
+    uint8_t* out = dst;
+    for (size_t start = 0; start < n; start += BLOCK_SIZE) {
+        size_t len = std::min(BLOCK_SIZE, n - start);
+        if (prefixSizes) {
+            writeU32(out, static_cast<uint32_t>(len));
+            out += 4;
+        }
+        out += encodeBlock(table, src + start, len, out);
     }
+    return out - dst;
+}
 
-    // Write header
-    std::string codesHeader = getHeader();
-    for (char c : codesHeader) outputFile.put(c);
-
-    // Encode content
-    unsigned char buffer = 0;
-    int bitsInBuffer = 0;
-
-    for (char c : content) {
-        const std::string& code = huffmanCodes.at(c);
-        for (char bit : code) {
-            buffer = (buffer << 1) | (bit - '0');
-            bitsInBuffer++;
-            if (bitsInBuffer == 8) {
-                outputFile.put(buffer);
-                buffer = 0;
-                bitsInBuffer = 0;
-            }
-        }
+size_t HuffmanCoding::compress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCapacity) {
+    if (dstCapacity < compressBound(srcSize)) throw std::runtime_error("Output buffer too small for Huffman encoding.");
+    // One pool serves both the histogram and the block coder.
+    size_t blockCount = (srcSize + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    std::unique_ptr<ThreadPool> pool;
+    if (blockCount > 1 && threads != 1)
+        pool.reset(new ThreadPool(std::min(blockCount, threads ? threads : ThreadPool::defaultThreads())));
+    buildFrequencyTable(src, srcSize, pool.get());
+    uint8_t lengths[256];
+    buildEncodeTable(lengths);
+
+    std::string header = getHeader(lengths, srcSize);
+    std::memcpy(dst, header.data(), header.size());
+
+    // As in LZ4Frame::compress, each block is coded into its worst-case slot
+    // of dst and then moved down to its final offset once every earlier
+    // block is in place; a block never ends up past its own slot.
+    const size_t slotSize = BLOCK_OVERHEAD + BLOCK_SIZE;
+    uint8_t* slotBase = dst + header.size();
+    const EncodeEntry* table = encodeTable;
+    auto encodeSlot = [=](size_t i) {
+        size_t start = i * BLOCK_SIZE;
+        return encodeBlock(table, src + start, std::min(BLOCK_SIZE, srcSize - start), slotBase + i * slotSize);
+    };
+
+    std::vector<size_t> blockBytes(blockCount);
+    if (pool) {
+        std::vector<std::future<size_t>> pending;
+        for (size_t i = 0; i < blockCount; i++) pending.push_back(pool->submit([&encodeSlot, i] { return encodeSlot(i); }));
+        for (size_t i = 0; i < blockCount; i++) blockBytes[i] = pending[i].get();
+    } else {
+        for (size_t i = 0; i < blockCount; i++) blockBytes[i] = encodeSlot(i);
     }
 
-    int padding = 0;
-    if (bitsInBuffer > 0) {
-        padding = 8 - bitsInBuffer;
-        buffer <<= padding;
-        outputFile.put(buffer);
+    uint8_t* out = slotBase;
+    for (size_t i = 0; i < blockCount; i++) {
+        uint8_t* slot = slotBase + i * slotSize;
+        if (out != slot) std::memmove(out, slot, blockBytes[i]);
+        out += blockBytes[i];
     }
+    return out - dst;
+}
 
-    // Save padding info as last byte
-    outputFile.put(static_cast<char>(padding));
+int HuffmanCoding::encode(const std::string& inFile, const std::string& outFile) {
+    try {
+        std::ifstream inStream;
+        std::ofstream outStream;
+        std::istream& in = openInput(inFile, inStream);
+        std::ostream& out = openOutput(outFile, outStream);
+        const size_t chunkSize = CHUNK_BLOCKS * BLOCK_SIZE;
+
+        // A file is counted in a first pass, so its codes fit all of it. A
+        // pipe cannot be read twice: its first chunk stands in for the whole
+        // input, and every byte value gets a code in case it turns up later.
+        // The pool that codes the chunks also counts them.
+        ThreadPool pool(threads);
+        unsigned long long symbolCount = 0;
+        std::vector<uint8_t> first;
+        if (isRegularFile(inFile)) {
+            std::array<uint64_t, 256> total{};
+            std::vector<uint8_t> chunk;
+            for (readChunk(in, chunk, chunkSize); !chunk.empty(); readChunk(in, chunk, chunkSize)) {
+                buildFrequencyTable(chunk.data(), chunk.size(), &pool);
+                for (int s = 0; s < 256; s++) total[s] += freqTable[s];
+                symbolCount += chunk.size();
+            }
+            freqTable = total;
+            in.clear();
+            if (!in.seekg(0)) throw std::runtime_error("Cannot rewind file : " + inFile);
+        } else {
+            readChunk(in, first, chunkSize);
+            buildFrequencyTable(first.data(), first.size(), &pool);
+            for (auto& f : freqTable) f = std::max<uint64_t>(f, 1);
+            symbolCount = UNKNOWN_SIZE;
+        }
 
-    outputFile.close();
+        uint8_t lengths[256];
+        buildEncodeTable(lengths);
+        std::string header = getHeader(lengths, symbolCount);
+        writeBytes(out, reinterpret_cast<const uint8_t*>(header.data()), header.size());
+
+        const bool prefixSizes = symbolCount == UNKNOWN_SIZE;
+        const EncodeEntry* table = encodeTable;
+        OrderedPipeline(pool).run(
+            [&](std::vector<uint8_t>& buf) {
+                if (!first.empty()) {
+                    buf.swap(first);
+                    first.clear();
+                } else {
+                    readChunk(in, buf, chunkSize);
+                }
+            },
+            [=](const std::vector<uint8_t>& data, std::vector<uint8_t>& coded) {
+                size_t blocks = (data.size() + BLOCK_SIZE - 1) / BLOCK_SIZE;
+                coded.resize(data.size() + blocks * (4 + BLOCK_OVERHEAD));
+                coded.resize(encodeChunk(table, data.data(), data.size(), prefixSizes, coded.data()));
+            },
+            [&](const std::vector<uint8_t>& coded) { writeBytes(out, coded.data(), coded.size()); });
+
+        if (prefixSizes) {
+            const uint8_t end[4] = {};
+            writeBytes(out, end, sizeof(end));
+        }
+        if (!out.flush()) throw std::runtime_error("Failed to write output.");
+    } catch (const std::exception& e) {
+        std::cerr << "Encoding failed: " << e.what() << std::endl;
+        return 1;
+    }
     return 0;
 }
 
 // ---------- Decode ----------
 
-std::string readBinaryDataFromFile(const std::string& filename) {
-    std::ifstream file(filename, std::ios::binary);
-    if (!file) {
-        std::cerr << "Error opening file: " << filename << std::endl;
-        return "";
+void HuffmanCoding::parseHeader(const uint8_t* src, size_t srcSize, Header& header) {
+    if (srcSize < sizeof(MAGIC) || std::memcmp(src, MAGIC, sizeof(MAGIC)) != 0) return parseLegacyHeader(src, srcSize, header);
+
+    size_t i = sizeof(MAGIC);
+    if (srcSize - i < 10) throw std::runtime_error("Invalid header format: truncated");
+    header.symbolCount = 0;
+    for (int k = 0; k < 8; k++) header.symbolCount |= static_cast<unsigned long long>(src[i + k]) << (8 * k);
+    i += 8;
+    unsigned blockLog = src[i++];
+    if (blockLog < 4 || blockLog > 30) throw std::runtime_error("Invalid header format: bad block size");
+    header.blockSize = size_t(1) << blockLog;
+    size_t highest = src[i++];
+    size_t packed = highest / 2 + 1;
+    if (srcSize - i < packed) throw std::runtime_error("Invalid header format: truncated");
+
+    uint8_t lengths[256] = {};
+    uint32_t kraft = 0;
+    for (size_t s = 0; s <= highest; s++) {
+        lengths[s] = (src[i + s / 2] >> (4 * (s & 1))) & 0xF;
+        if (lengths[s]) kraft += 1u << (MAX_CODE_LENGTH - lengths[s]);
     }
-    return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    i += packed;
+    if (kraft > (1u << MAX_CODE_LENGTH)) throw std::runtime_error("Invalid header format: code lengths oversubscribed");
+    canonicalCodes(lengths, header.codes);
+    header.dataStart = i;
+    header.dataEnd = srcSize;
 }
 
-int HuffmanCoding::decode(const std::string& filename) {
-    std::string fileContent = readBinaryDataFromFile(filename);
-    if (fileContent.empty()) return 1;
-
-    // Parse header - CORRECTED LOGIC
+void HuffmanCoding::parseLegacyHeader(const uint8_t* src, size_t srcSize, Header& header) {
+    std::vector<Code>& codes = header.codes;
     size_t i = 0;
-    std::unordered_map<std::string, char> codeToChar;
-    
-    while (i < fileContent.size() - 1) {
+    while (true) {
+        if (i + 1 >= srcSize) throw std::runtime_error("Invalid header format: missing end marker");
+
         // Check for header end marker
-        if (fileContent[i] == '~' && fileContent[i + 1] == '~') {
+        if (src[i] == '~' && src[i + 1] == '~') {
             i += 2; // skip both ~ characters
             break;
         }
-        
+
         // Read character
-        char character = fileContent[i++];
-        
+        Code code{src[i++], 0, 0};
+
         // Expect separator '|'
-        if (i >= fileContent.size() || fileContent[i] != '|') {
-            std::cerr << "Invalid header format: expected '|' separator" << std::endl;
-            return 1;
-        }
+        if (i >= srcSize || src[i] != '|')
+            throw std::runtime_error("Invalid header format: expected '|' separator");
         i++; // skip '|'
-        
+
         // Read code until '`' separator
-        std::string code;
-        while (i < fileContent.size() && fileContent[i] != '`') {
-            code += fileContent[i];
+        while (i < srcSize && src[i] != '`') {
+            if (src[i] != '0' && src[i] != '1') throw std::runtime_error("Invalid header format: bad code digit");
+            if (++code.length > REFILL_BITS) throw std::runtime_error("Huffman code too long");
+            code.bits = (code.bits << 1) | (src[i] - '0');
             i++;
         }
-        
-        if (i >= fileContent.size() || fileContent[i] != '`') {
-            std::cerr << "Invalid header format: expected '`' separator" << std::endl;
-            return 1;
-        }
+
+        if (i >= srcSize)
+            throw std::runtime_error("Invalid header format: expected '`' separator");
+        if (code.length == 0) throw std::runtime_error("Invalid header format: empty code");
         i++; // skip '`'
-        
-        // Store the mapping
-        codeToChar[code] = character;
+
+        codes.push_back(code);
     }
 
-    if (codeToChar.empty()) {
-        std::cerr << "No codes found in header" << std::endl;
-        return 1;
+    // Then the code bits, and a last byte counting the zero bits that pad
+    // them to a whole byte. The symbol count is not stored, so it is found
+    // by walking the codes.
+    if (i >= srcSize) throw std::runtime_error("Invalid file format: no data section");
+    unsigned padding = src[srcSize - 1];
+    header.dataStart = i;
+    header.dataEnd = srcSize - 1;
+    uint64_t dataBits = 8 * uint64_t(header.dataEnd - header.dataStart);
+    if (padding > 7 || padding > dataBits) throw std::runtime_error("Invalid file format: bad padding");
+    if (codes.empty() && dataBits > 0) throw std::runtime_error("No codes found in header");
+    header.symbolCount = dataBits ? countLegacySymbols(header, src, dataBits - padding) : 0;
+}
+
+namespace {
+enum : uint32_t { ENTRY_INVALID = 0, ENTRY_SYMBOL = 1, ENTRY_LINK = 2 };
+
+inline uint32_t makeEntry(uint32_t value, uint32_t kind, unsigned length) {
+    return (value << 8) | (kind << 4) | length;
+}
+inline uint32_t entryValue(uint32_t entry) { return entry >> 8; }
+inline uint32_t entryKind(uint32_t entry) { return (entry >> 4) & 0xF; }
+inline unsigned entryLength(uint32_t entry) { return entry & 0xF; }
+
+// MSB-first reader over one stream: bits are consumed from the top of bitBuf.
+struct BitReader {
+    const uint8_t* in;
+    const uint8_t* end;
+    uint64_t bitBuf = 0;
+    unsigned bitCount = 0;
+
+    BitReader(const uint8_t* begin, const uint8_t* end) : in(begin), end(end) {}
+
+    bool canRefillFast() const { return end - in >= 8; }
+
+    // One unaligned big-endian load tops the buffer up to at least 56 bits.
+    void refillFast() {
+        bitBuf |= loadBigEndian64(in) >> bitCount;
+        in += (63 - bitCount) >> 3;
+        bitCount |= 56;
     }
 
-    // Extract padding info (last byte)
-    if (i >= fileContent.size()) {
-        std::cerr << "Invalid file format: no data section" << std::endl;
-        return 1;
+    void refillTail() {
+        while (bitCount <= 56 && in < end) {
+            bitBuf |= static_cast<uint64_t>(*in++) << (56 - bitCount);
+            bitCount += 8;
+        }
+    }
+
+    // Returns the next symbol and consumes its code, walking subtables for
+    // codes longer than the primary table. Bits past the buffered ones read
+    // as zero, so the tail loop checks the length against bitCount first.
+    uint8_t decode(const uint32_t* table, unsigned primaryBits, bool checked) {
+        uint64_t bits = bitBuf;
+        unsigned width = primaryBits;
+        uint32_t entry = table[bits >> (64 - width)];
+        unsigned used = 0;
+        while (entryKind(entry) == ENTRY_LINK) {
+            bits <<= width;
+            used += width;
+            width = entryLength(entry);
+            entry = table[entryValue(entry) + (bits >> (64 - width))];
+        }
+        if (entryKind(entry) != ENTRY_SYMBOL) throw std::runtime_error("Invalid Huffman code in data");
+        used += entryLength(entry);
+        if (checked && used > bitCount) throw std::runtime_error("Encoded data ended early");
+        bitBuf <<= used;
+        bitCount -= used;
+        return static_cast<uint8_t>(entryValue(entry));
+    }
+};
+
+// Decodes n symbols from one stream. The fast loop refills once for every
+// perRefill codes, which 56 bits always cover, and never looks at the end of
+// the input; the tail refills byte by byte and checks every code.
+void decodeStream(const uint32_t* table, unsigned primaryBits, unsigned perRefill, BitReader& r, uint8_t* dst, size_t n) {
+    size_t written = 0;
+    while (r.canRefillFast() && n - written >= perRefill) {
+        r.refillFast();
+        for (unsigned k = 0; k < perRefill; k++) dst[written++] = r.decode(table, primaryBits, false);
+    }
+    while (written < n) {
+        r.refillTail();
+        dst[written++] = r.decode(table, primaryBits, true);
+    }
+}
+
+// Decodes four streams in lockstep. Their lookups are independent, so an
+// out-of-order core overlaps them instead of waiting on one stream's chain
+// of shifts and loads.
+void decodeFourStreams(const uint32_t* table, unsigned primaryBits, unsigned perRefill, BitReader* r,
+                       uint8_t* const* dst, const size_t* n) {
+    size_t common = std::min(std::min(n[0], n[1]), std::min(n[2], n[3]));
+    size_t done = 0;
+    BitReader r0 = r[0], r1 = r[1], r2 = r[2], r3 = r[3];
+    while (common - done >= perRefill && r0.canRefillFast() && r1.canRefillFast() && r2.canRefillFast() &&
+           r3.canRefillFast()) {
+        r0.refillFast();
+        r1.refillFast();
+        r2.refillFast();
+        r3.refillFast();
+        for (unsigned k = 0; k < perRefill; k++, done++) {
+            dst[0][done] = r0.decode(table, primaryBits, false);
+            dst[1][done] = r1.decode(table, primaryBits, false);
+            dst[2][done] = r2.decode(table, primaryBits, false);
+            dst[3][done] = r3.decode(table, primaryBits, false);
+        }
     }
-    
-    int padding = static_cast<unsigned char>(fileContent.back());
-    
-    // Extract encoded data (everything except the last byte which is padding)
-    std::string binaryStr;
-    for (size_t j = i; j < fileContent.size() - 1; j++) {
-        unsigned char byte = static_cast<unsigned char>(fileContent[j]);
-        binaryStr += std::bitset<8>(byte).to_string();
+    decodeStream(table, primaryBits, perRefill, r0, dst[0] + done, n[0] - done);
+    decodeStream(table, primaryBits, perRefill, r1, dst[1] + done, n[1] - done);
+    decodeStream(table, primaryBits, perRefill, r2, dst[2] + done, n[2] - done);
+    decodeStream(table, primaryBits, perRefill, r3, dst[3] + done, n[3] - done);
+}
+}
+
+// Decodes the legacy stream once without storing anything, to learn how
+// many symbols its bits hold; the codes must use them up exactly.
+unsigned long long HuffmanCoding::countLegacySymbols(const Header& header, const uint8_t* src, uint64_t codeBits) {
+    Header scratch;
+    scratch.codes = header.codes;
+    std::vector<uint32_t> table;
+    prepareDecodeTable(scratch, table);
+    BitReader reader(src + header.dataStart, src + header.dataEnd);
+    unsigned long long count = 0;
+    uint64_t consumed = 0;
+    while (consumed < codeBits) {
+        reader.refillTail();
+        unsigned before = reader.bitCount;
+        reader.decode(table.data(), PRIMARY_BITS, true);
+        consumed += before - reader.bitCount;
+        count++;
     }
+    if (consumed != codeBits) throw std::runtime_error("Invalid file format: padding does not end a code");
+    return count;
+}
 
-    // Remove padding bits
-    if (padding > 0 && padding < 8 && padding <= (int)binaryStr.size()) {
-        binaryStr = binaryStr.substr(0, binaryStr.size() - padding);
+// Fills table[base, base + 2^width) from codes whose earlier bits have
+// already been matched by the levels above; each code holds only its
+// remaining bits. Codes that do not fit get one subtable per distinct
+// prefix, as wide as the longest code behind it allows, up to PRIMARY_BITS.
+void HuffmanCoding::buildDecodeTable(std::vector<uint32_t>& table, size_t base, unsigned width, std::vector<Code>& codes) {
+    auto prefixOf = [width](const Code& c) { return c.bits >> (c.length - width); };
+    std::sort(codes.begin(), codes.end(), [&](const Code& a, const Code& b) {
+        bool aShort = a.length <= width, bShort = b.length <= width;
+        if (aShort != bShort) return aShort;
+        return !aShort && prefixOf(a) < prefixOf(b);
+    });
+
+    size_t k = 0;
+    for (; k < codes.size() && codes[k].length <= width; k++) {
+        const Code& c = codes[k];
+        size_t first = base + (c.bits << (width - c.length));
+        size_t count = size_t(1) << (width - c.length);
+        for (size_t e = first; e < first + count; e++) {
+            if (table[e] != ENTRY_INVALID) throw std::runtime_error("Invalid header format: codes are not prefix-free");
+            table[e] = makeEntry(c.symbol, ENTRY_SYMBOL, c.length);
+        }
     }
 
-    // Decode using the code-to-character mapping
-    std::string decodedText;
-    std::string currentCode;
-    
-    for (char bit : binaryStr) {
-        currentCode += bit;
-        
-        // Check if current code matches any Huffman code
-        auto it = codeToChar.find(currentCode);
-        if (it != codeToChar.end()) {
-            decodedText += it->second;
-            currentCode.clear();
+    while (k < codes.size()) {
+        uint64_t prefix = prefixOf(codes[k]);
+        std::vector<Code> rest;
+        unsigned longest = 0;
+        for (; k < codes.size() && prefixOf(codes[k]) == prefix; k++) {
+            Code c = codes[k];
+            c.length -= width;
+            c.bits &= (uint64_t(1) << c.length) - 1;
+            longest = std::max(longest, c.length);
+            rest.push_back(c);
         }
+        if (table[base + prefix] != ENTRY_INVALID) throw std::runtime_error("Invalid header format: codes are not prefix-free");
+        unsigned subWidth = std::min(longest, PRIMARY_BITS);
+        size_t subBase = table.size();
+        table.resize(subBase + (size_t(1) << subWidth), ENTRY_INVALID);
+        table[base + prefix] = makeEntry(static_cast<uint32_t>(subBase), ENTRY_LINK, subWidth);
+        buildDecodeTable(table, subBase, subWidth, rest);
     }
+}
+
+unsigned HuffmanCoding::prepareDecodeTable(Header& header, std::vector<uint32_t>& table) {
+    unsigned maxLength = 1;
+    for (const Code& c : header.codes) maxLength = std::max(maxLength, c.length);
+    table.assign(size_t(1) << PRIMARY_BITS, ENTRY_INVALID);
+    buildDecodeTable(table, 0, PRIMARY_BITS, header.codes);
+    return REFILL_BITS / maxLength;
+}
 
-    // Check if there are any unmatched bits (shouldn't happen with correct encoding)
-    if (!currentCode.empty()) {
-        std::cerr << "Warning: Unmatched code bits remaining: " << currentCode << std::endl;
+// Walks the block headers of blocked data and returns the decoded size, so
+// that blocks can then be decoded in any order straight into their place.
+size_t HuffmanCoding::scanBlocks(const uint8_t* src, size_t srcSize, const Header& header, std::vector<Block>& blocks) {
+    const bool sized = header.symbolCount == UNKNOWN_SIZE;
+    size_t pos = header.dataStart;
+    size_t out = 0;
+    while (sized || out < header.symbolCount) {
+        size_t len = std::min<unsigned long long>(header.blockSize, header.symbolCount - out);
+        if (sized) {
+            if (srcSize - pos < 4) throw std::runtime_error("Encoded data ended early");
+            len = readU32(src + pos);
+            pos += 4;
+            if (len == 0) break;
+            if (len > header.blockSize) throw std::runtime_error("Invalid block size");
+        }
+        if (srcSize - pos < 4) throw std::runtime_error("Encoded data ended early");
+        uint32_t word = readU32(src + pos);
+        Block b{pos + 4, word & ~RAW_BLOCK, out, len, (word & RAW_BLOCK) != 0};
+        if (srcSize - b.pos < b.size) throw std::runtime_error("Encoded data ended early");
+        // Every code is at least one bit, so a coded block holds at least
+        // len / 8 bytes of streams.
+        if (b.raw ? b.size != b.len : b.size < BLOCK_OVERHEAD - 4 || (b.size - (BLOCK_OVERHEAD - 4)) * 8 < b.len)
+            throw std::runtime_error("Invalid block size");
+        blocks.push_back(b);
+        pos = b.pos + b.size;
+        out += len;
     }
+    return out;
+}
 
-    // Write decoded output
-    std::ofstream output("decoded_output.txt");
-    if (!output) {
-        std::cerr << "Failed to write decoded output." << std::endl;
-        return 1;
+void HuffmanCoding::decodeBlock(const uint32_t* table, unsigned perRefill, const uint8_t* src, const Block& b, uint8_t* dst) {
+    if (b.raw) {
+        std::memcpy(dst + b.out, src + b.pos, b.len);
+        return;
     }
-    output << decodedText;
-    output.close();
-    
-    std::cout << "Decoding completed successfully. Output written to decoded_output.txt" << std::endl;
-    return 0;
+    size_t quarter = (b.len + 3) / 4;
+    BitReader readers[4] = {{nullptr, nullptr}, {nullptr, nullptr}, {nullptr, nullptr}, {nullptr, nullptr}};
+    uint8_t* outs[4];
+    size_t lens[4];
+    const uint8_t* in = src + b.pos + BLOCK_OVERHEAD - 4;
+    const uint8_t* end = src + b.pos + b.size;
+    for (int k = 0; k < 4; k++) {
+        size_t start = std::min(b.len, k * quarter);
+        size_t streamSize = (k < 3) ? readU32(src + b.pos + 4 * k) : static_cast<size_t>(end - in);
+        if (static_cast<size_t>(end - in) < streamSize) throw std::runtime_error("Invalid stream size");
+        readers[k] = BitReader(in, in + streamSize);
+        in += streamSize;
+        outs[k] = dst + b.out + start;
+        lens[k] = std::min(quarter, b.len - start);
+    }
+    decodeFourStreams(table, PRIMARY_BITS, perRefill, readers, outs, lens);
 }
 
-// ---------- Node Methods ----------
+size_t HuffmanCoding::decompressedSize(const uint8_t* src, size_t srcSize) {
+    Header header;
+    parseHeader(src, srcSize, header);
+    // The legacy count was found by walking the codes. A blocked header's
+    // count is only a claim, so the blocks have to back it up before any
+    // caller allocates that much.
+    if (header.blockSize == 0) return header.symbolCount;
+    std::vector<Block> blocks;
+    return scanBlocks(src, srcSize, header, blocks);
+}
 
-HuffmanCoding::Node::Node(char character, int frequency)
-    : ch(character), freq(frequency), left(nullptr), right(nullptr) {}
+size_t HuffmanCoding::decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCapacity) {
+    Header header;
+    parseHeader(src, srcSize, header);
+    std::vector<Block> blocks;
+    const size_t symbolCount = header.blockSize ? scanBlocks(src, srcSize, header, blocks) : header.symbolCount;
+    if (symbolCount > dstCapacity) throw std::runtime_error("Output buffer too small for Huffman decoding.");
+    if (symbolCount == 0) return 0;
+
+    std::vector<uint32_t> table;
+    const unsigned perRefill = prepareDecodeTable(header, table);
+
+    if (header.blockSize == 0) {
+        BitReader reader(src + header.dataStart, src + header.dataEnd);
+        decodeStream(table.data(), PRIMARY_BITS, perRefill, reader, dst, symbolCount);
+        return symbolCount;
+    }
 
-bool HuffmanCoding::Node::isLeaf() const {
-    return !left && !right;
+    const uint32_t* decodeTable = table.data();
+    if (blocks.size() > 1 && threads != 1) {
+        ThreadPool pool(std::min(blocks.size(), threads ? threads : ThreadPool::defaultThreads()));
+        std::vector<std::future<void>> pending;
+        for (const Block& b : blocks)
+            pending.push_back(pool.submit([=] { decodeBlock(decodeTable, perRefill, src, b, dst); }));
+        for (auto& p : pending) p.get();
+    } else {
+        for (const Block& b : blocks) decodeBlock(decodeTable, perRefill, src, b, dst);
+    }
+    return symbolCount;
 }
 
-// ---------- Compare ----------
+const EntropyCoder& HuffmanCoding::entropyCoder() {
+    static const EntropyCoder coder{
+        "huffman", compressBound,
+        [](const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCapacity) {
+            return HuffmanCoding(1).compress(src, srcSize, dst, dstCapacity);
+        },
+        decompressedSize,
+        [](const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCapacity) {
+            return HuffmanCoding(1).decompress(src, srcSize, dst, dstCapacity);
+        }};
+    return coder;
+}
 
-bool HuffmanCoding::Compare::operator()(const Node* a, const Node* b) {
-    return a->freq > b->freq; // Min-heap
-}
\ No newline at end of file
+// Blocked data is decoded as it is read: the reader gathers whole blocks
+// into chunks, each rewritten as size-prefixed blocks ending in a zero size,
+// so a chunk decodes on its own wherever it falls in the file. The legacy
+// text-header layout is read whole and decoded in memory.
+int HuffmanCoding::decode(const std::string& inFile, const std::string& outFile) {
+    try {
+        std::ifstream inStream;
+        std::ofstream outStream;
+        std::istream& in = openInput(inFile, inStream);
+        std::ostream& out = openOutput(outFile, outStream);
+
+        std::vector<uint8_t> head;
+        readChunk(in, head, sizeof(MAGIC) + 8 + 1 + 1);
+        if (head.size() < sizeof(MAGIC) || std::memcmp(head.data(), MAGIC, sizeof(MAGIC)) != 0) {
+            std::vector<uint8_t> chunk;
+            for (readChunk(in, chunk, CHUNK_BLOCKS * BLOCK_SIZE); !chunk.empty(); readChunk(in, chunk, CHUNK_BLOCKS * BLOCK_SIZE))
+                head.insert(head.end(), chunk.begin(), chunk.end());
+            std::vector<uint8_t> decoded(decompressedSize(head.data(), head.size()));
+            decompress(head.data(), head.size(), decoded.data(), decoded.size());
+            writeBytes(out, decoded.data(), decoded.size());
+        } else {
+            if (head.size() < sizeof(MAGIC) + 8 + 1 + 1) throw std::runtime_error("Invalid header format: truncated");
+            appendExact(in, head, head.back() / 2 + 1);
+            Header header;
+            parseHeader(head.data(), head.size(), header);
+            std::vector<uint32_t> table;
+            const unsigned perRefill = prepareDecodeTable(header, table);
+
+            const bool sized = header.symbolCount == UNKNOWN_SIZE;
+            unsigned long long remaining = header.symbolCount;
+            bool ended = false;
+            auto readBlocks = [&](std::vector<uint8_t>& buf) {
+                for (size_t k = 0; k < CHUNK_BLOCKS && !ended; k++) {
+                    size_t len;
+                    if (sized) {
+                        appendExact(in, buf, 4);
+                        len = readU32(buf.data() + buf.size() - 4);
+                        buf.resize(buf.size() - 4);
+                        if (len > header.blockSize) throw std::runtime_error("Invalid block size");
+                    } else {
+                        len = std::min<unsigned long long>(header.blockSize, remaining);
+                        remaining -= len;
+                    }
+                    if (len == 0) {
+                        ended = true;
+                        break;
+                    }
+                    buf.resize(buf.size() + 4);
+                    writeU32(buf.data() + buf.size() - 4, static_cast<uint32_t>(len));
+                    appendExact(in, buf, 4);
+                    size_t size = readU32(buf.data() + buf.size() - 4) & ~RAW_BLOCK;
+                    if (size > len + BLOCK_OVERHEAD) throw std::runtime_error("Invalid block size");
+                    appendExact(in, buf, size);
+                }
+                if (!buf.empty()) buf.resize(buf.size() + 4, 0);
+            };
+
+            Header chunkHeader;
+            chunkHeader.symbolCount = UNKNOWN_SIZE;
+            chunkHeader.blockSize = header.blockSize;
+            const uint32_t* decodeTable = table.data();
+            ThreadPool pool(threads);
+            OrderedPipeline(pool).run(
+                readBlocks,
+                [=](const std::vector<uint8_t>& data, std::vector<uint8_t>& decoded) {
+                    std::vector<Block> blocks;
+                    decoded.resize(scanBlocks(data.data(), data.size(), chunkHeader, blocks));
+                    for (const Block& b : blocks) decodeBlock(decodeTable, perRefill, data.data(), b, decoded.data());
+                },
+                [&](const std::vector<uint8_t>& decoded) { writeBytes(out, decoded.data(), decoded.size()); });
+        }
+        if (!out.flush()) throw std::runtime_error("Failed to write output.");
+    } catch (const std::exception& e) {
+        std::cerr << "Decoding failed: " << e.what() << std::endl;
+        return 1;
+    }
+
+    if (outFile == "-") {
+        std::cerr << "Decoding completed successfully. Output written to standard output" << std::endl;
+    } else {
+        std::cout << "Decoding completed successfully. Output written to " << outFile << std::endl;
+    }
+    return 0;
+}
@@ -1,50 +1,145 @@
 #ifndef HUFFMAN_CODING_HPP
 #define HUFFMAN_CODING_HPP
 
+#include <array>
 #include <string>
-#include <unordered_map>
-#include <queue>
-#include <memory>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "../common/entropy_coder.h"
+
+class ThreadPool;
+
 using namespace std;
 
 class HuffmanCoding {
 public:
-    HuffmanCoding();                         
-    ~HuffmanCoding();                        
+    // threads = 0 uses one per hardware thread.
+    explicit HuffmanCoding(size_t threads = 0);
 
 
-    // Encodes the input text using the generated Huffman codes
-    int encode(const std::string& text) ;
+    // File to file, where "-" is stdin or stdout. The input is read in
+    // chunks of whole blocks that are coded on `threads` threads, so memory
+    // use does not grow with its size. A regular input file is read twice,
+    // first to count its symbols; any other input is coded with codes built
+    // from its first chunk. Both print the error and return 1 on failure.
+    int encode(const std::string& inFile, const std::string& outFile);
+    int decode(const std::string& inFile, const std::string& outFile);
 
-    // Decodes the encoded string back to original text
-    int decode(const std::string& encodedText) ;
+    // In-memory codec over caller-owned buffers; both throw
+    // std::runtime_error on malformed input or a too-small dst. compress()
+    // needs dstCapacity >= compressBound(srcSize). Blocks are coded on
+    // `threads` threads.
+    static size_t compressBound(size_t srcSize);
+    size_t compress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCapacity);
+    static size_t decompressedSize(const uint8_t* src, size_t srcSize);
+    size_t decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCapacity);
 
+    // The in-memory codec on the calling thread alone, as an EntropyCoder.
+    static const EntropyCoder& entropyCoder();
 
 private:
+    // Tree nodes live in one array: the leaves first, sorted by frequency,
+    // then the internal nodes in the order they are merged, so every node's
+    // parent comes after it and the root is last.
     struct Node {
-        char ch;
         unsigned long long freq;
-        Node *left;
-        Node *right;
-
-        Node(char character, int frequency);
-        bool isLeaf() const;
+        uint16_t parent;
+        uint8_t symbol;
     };
+    static constexpr size_t MAX_NODES = 2 * 256 - 1;
 
-   struct Compare {
-        bool operator()(const Node* a, const Node* b);
+    // Encoder codes by symbol, first bit highest; length 0 for absent symbols.
+    struct EncodeEntry {
+        uint32_t bits;
+        uint32_t length;
     };
 
-    Node *root;
-    unordered_map<char, string> huffmanCodes;
-    unordered_map<char, unsigned long long> freqTable;
+    size_t threads;
+    array<Node, MAX_NODES> nodes;
+    size_t leafCount = 0;
+    EncodeEntry encodeTable[256];
+    array<uint64_t, 256> freqTable;
+
+    // Compressed data starts with MAGIC, the symbol count (8 bytes, little
+    // endian), log2 of the block size, the highest symbol present and then
+    // one 4-bit code length per symbol up to it. Codes are canonical and at
+    // most MAX_CODE_LENGTH bits, so the lengths alone rebuild them.
+    //
+    // Blocks follow, one per BLOCK_SIZE input bytes, all sharing the code.
+    // Each starts with a 4-byte little-endian payload size. If RAW_BLOCK is
+    // set in it, the payload is the block's bytes as they are. Otherwise it
+    // holds the sizes of streams 0-2 (4 bytes each) and then four
+    // independently decodable streams, each coding a quarter of the block.
+    //
+    // A symbol count of UNKNOWN_SIZE, written when the input is a pipe,
+    // means every block is preceded by the number of bytes it codes (4
+    // bytes, little endian) and a zero count ends the data.
+    //
+    // Files from the original tool are still decoded: a text header of
+    // "symbol|code`" entries ending in "~~", then a single stream of code
+    // bits and a last byte holding the number of padding bits.
+    static constexpr uint8_t MAGIC[4] = {'H', 'U', 'F', 'B'};
+    static constexpr unsigned MAX_CODE_LENGTH = 15;
+    static constexpr size_t HEADER_BOUND = sizeof(MAGIC) + 8 + 1 + 1 + 128;
+    static constexpr unsigned BLOCK_LOG = 18;
+    static constexpr size_t BLOCK_SIZE = size_t(1) << BLOCK_LOG;
+    static constexpr uint32_t RAW_BLOCK = 0x80000000u;
+    static constexpr size_t BLOCK_OVERHEAD = 4 + 3 * 4;
+    static constexpr unsigned long long UNKNOWN_SIZE = ~0ull;
+    // Blocks per chunk in the file to file coders.
+    static constexpr size_t CHUNK_BLOCKS = 16;
+
+    struct Code {
+        uint8_t symbol;
+        unsigned length;
+        uint64_t bits; // the code in the low `length` bits, first bit highest
+    };
 
-    void buildFrequencyTable(const string& text);
+    void buildFrequencyTable(const uint8_t* text, size_t size, ThreadPool* pool = nullptr);
     void buildTree();
     string compress();
-    string getHeader();
-    void generateCodes(Node *node, const string& code);
-    void freeTree(Node* node) ;
+    void treeDepths(uint8_t* depths) const;
+    void limitCodeLengths(uint8_t* lengths) const;
+    void buildEncodeTable(uint8_t* lengths);
+    static string getHeader(const uint8_t* lengths, unsigned long long symbolCount);
+    static void canonicalCodes(const uint8_t* lengths, vector<Code>& codes);
+    static size_t encodeStream(const EncodeEntry* table, const uint8_t* src, size_t n, uint8_t* dst, size_t capacity);
+    static size_t encodeBlock(const EncodeEntry* table, const uint8_t* src, size_t n, uint8_t* dst);
+    static size_t encodeChunk(const EncodeEntry* table, const uint8_t* src, size_t n, bool prefixSizes, uint8_t* dst);
+
+    // Decoding resolves codes of up to PRIMARY_BITS bits with one lookup in
+    // the primary table; longer codes link to subtables indexed by the bits
+    // that follow. Entries pack (value << 8) | (kind << 4) | length, where
+    // value is the symbol or the subtable's offset, and length is the code
+    // bits the entry consumes or the subtable's index width.
+    static constexpr unsigned PRIMARY_BITS = 11;
+    // Bits the decoder always has buffered after a refill.
+    static constexpr unsigned REFILL_BITS = 56;
+
+    struct Header {
+        vector<Code> codes;
+        unsigned long long symbolCount = 0;
+        size_t dataStart = 0;
+        size_t dataEnd = 0;
+        size_t blockSize = 0; // 0 for the legacy layout
+    };
+
+    struct Block {
+        size_t pos;  // start of the payload in the compressed data
+        size_t size; // payload bytes
+        size_t out;  // offset of the decoded bytes in the output
+        size_t len;  // decoded bytes
+        bool raw;
+    };
+
+    static void parseHeader(const uint8_t* src, size_t srcSize, Header& header);
+    static void parseLegacyHeader(const uint8_t* src, size_t srcSize, Header& header);
+    static unsigned long long countLegacySymbols(const Header& header, const uint8_t* src, uint64_t codeBits);
+    static void buildDecodeTable(vector<uint32_t>& table, size_t base, unsigned width, vector<Code>& codes);
+    static unsigned prepareDecodeTable(Header& header, vector<uint32_t>& table);
+    static size_t scanBlocks(const uint8_t* src, size_t srcSize, const Header& header, vector<Block>& blocks);
+    static void decodeBlock(const uint32_t* table, unsigned perRefill, const uint8_t* src, const Block& block, uint8_t* dst);
 };
 
 #endif 
@@ -1,15 +1,32 @@
 #include "HuffmanCoding.hpp"
 #include <iostream>
-#include <string.h>
+#include <string>
+#include <vector>
 
 using namespace std;
-int main(int argc,char** argv){
-    cout<<argv[1]<<" "<<argv[2]<<endl;
-    HuffmanCoding obj;
-     if (strcmp(argv[1], "compress") == 0) {
-        obj.encode(argv[2]);
-    } else {
-        obj.decode(argv[2]);
+int main(int argc, char** argv) {
+    size_t threads = 0;
+    vector<string> args;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.rfind("-T", 0) == 0) {
+            string value = arg.size() > 2 ? arg.substr(2) : (i + 1 < argc ? argv[++i] : "");
+            try {
+                threads = stoul(value);
+            } catch (const exception&) {
+                cerr << "Invalid thread count: " << value << '\n';
+                return 1;
+            }
+        } else {
+            args.push_back(arg);
+        }
     }
-    return 0;
-}
\ No newline at end of file
+    if (args.size() != 3 || (args[0] != "compress" && args[0] != "decompress")) {
+        cerr << "Usage: huffman [-T threads] <compress|decompress> <input_file|-> <output_file|->\n";
+        return 1;
+    }
+
+    HuffmanCoding obj(threads);
+    if (args[0] == "compress") return obj.encode(args[1], args[2]);
+    return obj.decode(args[1], args[2]);
+}
@@ -0,0 +1,402 @@
+#include "TANSCoding.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+// Index of the highest set bit; v must not be 0.
+inline unsigned highBit(uint32_t v) {
+    return 31 - __builtin_clz(v);
+}
+
+// Spelled out byte by byte so that compilers turn them into a single load
+// or store.
+inline uint64_t loadLittleEndian64(const uint8_t* p) {
+    return uint64_t(p[0]) | (uint64_t(p[1]) << 8) | (uint64_t(p[2]) << 16) | (uint64_t(p[3]) << 24) |
+           (uint64_t(p[4]) << 32) | (uint64_t(p[5]) << 40) | (uint64_t(p[6]) << 48) | (uint64_t(p[7]) << 56);
+}
+
+inline void storeLittleEndian64(uint8_t* p, uint64_t v) {
+    p[0] = static_cast<uint8_t>(v);
+    p[1] = static_cast<uint8_t>(v >> 8);
+    p[2] = static_cast<uint8_t>(v >> 16);
+    p[3] = static_cast<uint8_t>(v >> 24);
+    p[4] = static_cast<uint8_t>(v >> 32);
+    p[5] = static_cast<uint8_t>(v >> 40);
+    p[6] = static_cast<uint8_t>(v >> 48);
+    p[7] = static_cast<uint8_t>(v >> 56);
+}
+
+size_t writeVarint(uint64_t v, uint8_t* dst) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        dst[n++] = static_cast<uint8_t>(v) | 0x80;
+        v >>= 7;
+    }
+    dst[n++] = static_cast<uint8_t>(v);
+    return n;
+}
+
+uint64_t readVarint(const uint8_t* src, size_t srcSize, size_t& pos) {
+    uint64_t v = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        if (pos >= srcSize) throw std::runtime_error("Invalid tANS header: truncated");
+        uint8_t b = src[pos++];
+        v |= static_cast<uint64_t>(b & 0x7F) << shift;
+        if (!(b & 0x80)) return v;
+    }
+    throw std::runtime_error("Invalid tANS header: varint too long");
+}
+
+// Forward writer, first bit lowest. Every flush stores 8 bytes, so it needs
+// 8 bytes of room past out and reports false once that runs out.
+struct BitWriter {
+    uint8_t* out;
+    uint8_t* limit; // last position a flush may store at
+    uint64_t acc = 0;
+    unsigned bits = 0;
+
+    // value must fit in n bits, and at most 56 bits may be pending.
+    void add(uint64_t value, unsigned n) {
+        acc |= value << bits;
+        bits += n;
+    }
+
+    bool flush() {
+        if (out > limit) return false;
+        storeLittleEndian64(out, acc);
+        out += bits >> 3;
+        acc >>= bits & ~7u;
+        bits &= 7;
+        return true;
+    }
+};
+
+// Reads a BitWriter's stream from its end backwards: the last bits written
+// come out first. consumed counts the bits used from the top of container.
+struct BitReader {
+    const uint8_t* start;
+    const uint8_t* ptr;
+    uint64_t container;
+    unsigned consumed;
+
+    BitReader(const uint8_t* src, size_t n) : start(src) {
+        if (n == 0 || src[n - 1] == 0) throw std::runtime_error("Invalid tANS stream: missing end marker");
+        unsigned marker = 8 - highBit(src[n - 1]); // the marker and the zero bits above it
+        if (n >= 8) {
+            ptr = src + n - 8;
+            container = loadLittleEndian64(ptr);
+            consumed = marker;
+        } else {
+            ptr = src;
+            container = 0;
+            for (size_t i = 0; i < n; i++) container |= static_cast<uint64_t>(src[i]) << (8 * i);
+            consumed = static_cast<unsigned>(8 - n) * 8 + marker;
+        }
+    }
+
+    // n may be 0; the double shift keeps every shift count below 64.
+    uint32_t read(unsigned n) {
+        uint64_t v = ((container << (consumed & 63)) >> 1) >> ((63 - n) & 63);
+        consumed += n;
+        return static_cast<uint32_t>(v);
+    }
+
+    // Moves ptr back over the whole bytes consumed, stopping at start.
+    void reload() {
+        if (consumed > 64) throw std::runtime_error("Invalid tANS stream: overrun");
+        size_t back = std::min<size_t>(consumed >> 3, ptr - start);
+        if (back == 0) return;
+        ptr -= back;
+        consumed -= static_cast<unsigned>(back * 8);
+        container = loadLittleEndian64(ptr);
+    }
+};
+}
+
+// ---------- Tables ----------
+
+// Large enough that each symbol's share is represented finely, but no
+// larger than the input warrants, and never too small for every symbol
+// present to get a state.
+unsigned TANSCoding::chooseTableLog(size_t srcSize, unsigned symbolsPresent, unsigned maxTableLog) {
+    unsigned tableLog = std::min(std::max(maxTableLog, MIN_TABLE_LOG), MAX_TABLE_LOG);
+    if (srcSize > 1) tableLog = std::min(tableLog, std::max(MIN_TABLE_LOG, highBit(static_cast<uint32_t>(std::min<size_t>(srcSize - 1, UINT32_MAX))) - 1));
+    tableLog = std::max(tableLog, highBit(symbolsPresent) + 1);
+    return std::max(tableLog, MIN_TABLE_LOG);
+}
+
+// Scales counts to sum to 1 << tableLog, giving every symbol present at least
+// 1. The rounding error is taken from (or given to) the largest shares,
+// where it changes the cost per symbol least.
+void TANSCoding::normalizeCounts(const uint64_t* counts, size_t total, unsigned tableLog, uint16_t* norm) {
+    const uint32_t tableSize = 1u << tableLog;
+    int64_t sum = 0;
+    int largest = 0;
+    for (int s = 0; s < 256; s++) {
+        norm[s] = 0;
+        if (!counts[s]) continue;
+        uint32_t share = static_cast<uint32_t>(static_cast<double>(counts[s]) * tableSize / total + 0.5);
+        norm[s] = static_cast<uint16_t>(std::max<uint32_t>(1, share));
+        sum += norm[s];
+        if (counts[s] > counts[largest]) largest = s;
+    }
+    int64_t diff = static_cast<int64_t>(tableSize) - sum;
+    if (diff > 0) norm[largest] = static_cast<uint16_t>(norm[largest] + diff);
+    while (diff < 0) {
+        int s = static_cast<int>(std::max_element(norm, norm + 256) - norm);
+        norm[s]--;
+        diff++;
+    }
+}
+
+// Scatters each symbol's states over the table with a step coprime to its
+// size, so a symbol's states are spread out rather than clustered.
+void TANSCoding::spreadSymbols(const uint16_t* norm, unsigned maxSymbol, unsigned tableLog, uint8_t* tableSymbol) {
+    const uint32_t tableSize = 1u << tableLog;
+    const uint32_t mask = tableSize - 1;
+    const uint32_t step = (tableSize >> 1) + (tableSize >> 3) + 3;
+    uint32_t pos = 0;
+    for (unsigned s = 0; s <= maxSymbol; s++) {
+        for (unsigned i = 0; i < norm[s]; i++) {
+            tableSymbol[pos] = static_cast<uint8_t>(s);
+            pos = (pos + step) & mask;
+        }
+    }
+}
+
+size_t TANSCoding::writeTableHeader(const uint16_t* norm, unsigned maxSymbol, uint8_t* dst) {
+    size_t n = 0;
+    dst[n++] = static_cast<uint8_t>(maxSymbol);
+    for (unsigned s = 0; s <= maxSymbol;) {
+        n += writeVarint(norm[s], dst + n);
+        if (norm[s]) {
+            s++;
+            continue;
+        }
+        unsigned run = 0;
+        while (s + 1 + run <= maxSymbol && run < 255 && norm[s + 1 + run] == 0) run++;
+        dst[n++] = static_cast<uint8_t>(run);
+        s += 1 + run;
+    }
+    return n;
+}
+
+size_t TANSCoding::readTableHeader(const uint8_t* src, size_t srcSize, unsigned tableLog, uint16_t* norm, unsigned& maxSymbol) {
+    std::fill(norm, norm + 256, 0);
+    if (srcSize < 1) throw std::runtime_error("Invalid tANS header: truncated");
+    size_t pos = 0;
+    maxSymbol = src[pos++];
+    uint32_t sum = 0;
+    for (unsigned s = 0; s <= maxSymbol;) {
+        uint64_t v = readVarint(src, srcSize, pos);
+        if (v > (1u << tableLog)) throw std::runtime_error("Invalid tANS header: count too large");
+        norm[s] = static_cast<uint16_t>(v);
+        sum += static_cast<uint32_t>(v);
+        if (v) {
+            s++;
+            continue;
+        }
+        if (pos >= srcSize) throw std::runtime_error("Invalid tANS header: truncated");
+        s += 1 + src[pos++];
+    }
+    if (sum != (1u << tableLog)) throw std::runtime_error("Invalid tANS header: counts do not fill the table");
+    return pos;
+}
+
+// ---------- Encode ----------
+
+size_t TANSCoding::compressBound(size_t srcSize) {
+    return 10 + 1 + srcSize; // varint count, mode byte, raw bytes
+}
+
+size_t TANSCoding::compress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCapacity, unsigned maxTableLog) {
+    if (dstCapacity < compressBound(srcSize)) throw std::runtime_error("Output buffer too small for tANS encoding.");
+    size_t headerSize = writeVarint(srcSize, dst);
+    const size_t rawSize = headerSize + 1 + srcSize;
+    auto storeRaw = [&]() {
+        dst[headerSize] = MODE_RAW;
+        if (srcSize) std::memcpy(dst + headerSize + 1, src, srcSize);
+        return rawSize;
+    };
+
+    uint64_t counts[4][256] = {};
+    size_t i = 0;
+    for (; i + 4 <= srcSize; i += 4) {
+        counts[0][src[i]]++;
+        counts[1][src[i + 1]]++;
+        counts[2][src[i + 2]]++;
+        counts[3][src[i + 3]]++;
+    }
+    for (; i < srcSize; i++) counts[0][src[i]]++;
+    unsigned present = 0, maxSymbol = 0;
+    for (int s = 0; s < 256; s++) {
+        counts[0][s] += counts[1][s] + counts[2][s] + counts[3][s];
+        if (counts[0][s]) {
+            present++;
+            maxSymbol = s;
+        }
+    }
+    if (present == 0) return storeRaw();
+    if (present == 1) {
+        dst[headerSize] = MODE_SINGLE;
+        dst[headerSize + 1] = static_cast<uint8_t>(maxSymbol);
+        return headerSize + 2;
+    }
+
+    const unsigned tableLog = chooseTableLog(srcSize, present, maxTableLog);
+    const uint32_t tableSize = 1u << tableLog;
+    uint16_t norm[256];
+    normalizeCounts(counts[0], srcSize, tableLog, norm);
+
+    // Give up early if the table header and one flush do not fit in the
+    // raw size.
+    uint8_t tableHeader[1 + 2 * 256];
+    size_t tableHeaderSize = writeTableHeader(norm, maxSymbol, tableHeader);
+    size_t pos = headerSize + 1;
+    if (pos + tableHeaderSize + 8 > rawSize) return storeRaw();
+    dst[headerSize] = static_cast<uint8_t>(tableLog);
+    std::memcpy(dst + pos, tableHeader, tableHeaderSize);
+    pos += tableHeaderSize;
+
+    uint8_t tableSymbol[1u << MAX_TABLE_LOG];
+    spreadSymbols(norm, maxSymbol, tableLog, tableSymbol);
+    uint16_t stateTable[1u << MAX_TABLE_LOG];
+    uint32_t cumul[257];
+    cumul[0] = 0;
+    for (int s = 0; s < 256; s++) cumul[s + 1] = cumul[s] + norm[s];
+    {
+        uint32_t next[256];
+        std::copy(cumul, cumul + 256, next);
+        for (uint32_t u = 0; u < tableSize; u++) stateTable[next[tableSymbol[u]]++] = static_cast<uint16_t>(tableSize + u);
+    }
+    EncodeEntry symbolTT[256] = {};
+    for (unsigned s = 0; s <= maxSymbol; s++) {
+        if (norm[s] == 0) continue;
+        if (norm[s] == 1) {
+            symbolTT[s].deltaNbBits = (tableLog << 16) - tableSize;
+            symbolTT[s].deltaFindState = static_cast<int32_t>(cumul[s]) - 1;
+        } else {
+            unsigned maxBitsOut = tableLog - highBit(norm[s] - 1u);
+            uint32_t minStatePlus = static_cast<uint32_t>(norm[s]) << maxBitsOut;
+            symbolTT[s].deltaNbBits = (maxBitsOut << 16) - minStatePlus;
+            symbolTT[s].deltaFindState = static_cast<int32_t>(cumul[s]) - norm[s];
+        }
+    }
+
+    // Symbols are coded last to first, so that the decoder, which reads the
+    // bits back in reverse, produces them in order. Even and odd positions
+    // use separate states, which gives the decoder two independent chains
+    // of table lookups. A state always lies in [tableSize, 2 * tableSize).
+    BitWriter writer{dst + pos, dst + rawSize - 8};
+    uint32_t states[2] = {tableSize, tableSize};
+    auto encode = [&](size_t k) {
+        uint32_t& state = states[k & 1];
+        const EncodeEntry e = symbolTT[src[k]];
+        unsigned nbBits = (state + e.deltaNbBits) >> 16;
+        writer.add(state & ((1u << nbBits) - 1), nbBits);
+        state = stateTable[(state >> nbBits) + e.deltaFindState];
+    };
+    i = srcSize;
+    while (i % 4) encode(--i);
+    if (!writer.flush()) return storeRaw();
+    while (i > 0) {
+        encode(i - 1);
+        encode(i - 2);
+        encode(i - 3);
+        encode(i - 4);
+        i -= 4;
+        if (!writer.flush()) return storeRaw();
+    }
+    writer.add(states[1] - tableSize, tableLog);
+    writer.add(states[0] - tableSize, tableLog);
+    writer.add(1, 1); // end marker
+    if (!writer.flush()) return storeRaw();
+    size_t total = (writer.out - dst) + (writer.bits ? 1 : 0);
+    return total < rawSize ? total : storeRaw();
+}
+
+// ---------- Decode ----------
+
+size_t TANSCoding::decompressedSize(const uint8_t* src, size_t srcSize) {
+    size_t pos = 0;
+    uint64_t count = readVarint(src, srcSize, pos);
+    if (count > SIZE_MAX) throw std::runtime_error("Invalid tANS header: size too large");
+    return static_cast<size_t>(count);
+}
+
+size_t TANSCoding::decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCapacity) {
+    size_t pos = 0;
+    const uint64_t count = readVarint(src, srcSize, pos);
+    if (count > dstCapacity) throw std::runtime_error("Output buffer too small for tANS decoding.");
+    if (pos >= srcSize) throw std::runtime_error("Invalid tANS header: truncated");
+    const uint8_t mode = src[pos++];
+    if (mode == MODE_RAW) {
+        if (srcSize - pos != count) throw std::runtime_error("Invalid tANS data: raw size mismatch");
+        if (count) std::memcpy(dst, src + pos, count);
+        return count;
+    }
+    if (mode == MODE_SINGLE) {
+        if (srcSize - pos != 1) throw std::runtime_error("Invalid tANS data: bad single-symbol block");
+        if (count) std::memset(dst, src[pos], count);
+        return count;
+    }
+    if (mode < MIN_TABLE_LOG || mode > MAX_TABLE_LOG) throw std::runtime_error("Invalid tANS header: bad table log");
+    const unsigned tableLog = mode;
+    const uint32_t tableSize = 1u << tableLog;
+    uint16_t norm[256];
+    unsigned maxSymbol;
+    pos += readTableHeader(src + pos, srcSize - pos, tableLog, norm, maxSymbol);
+
+    uint8_t tableSymbol[1u << MAX_TABLE_LOG];
+    spreadSymbols(norm, maxSymbol, tableLog, tableSymbol);
+    DecodeEntry table[1u << MAX_TABLE_LOG];
+    uint32_t next[256];
+    std::copy(norm, norm + 256, next);
+    for (uint32_t u = 0; u < tableSize; u++) {
+        uint8_t s = tableSymbol[u];
+        uint32_t x = next[s]++;
+        unsigned nbBits = tableLog - highBit(x);
+        table[u] = {static_cast<uint16_t>((x << nbBits) - tableSize), s, static_cast<uint8_t>(nbBits)};
+    }
+
+    // Each step is a table load, a symbol store and a bit read, with no
+    // branches, alternating between the even and odd states. After a reload
+    // at least 57 bits are buffered, enough for four symbols of up to
+    // MAX_TABLE_LOG bits.
+    BitReader reader(src + pos, srcSize - pos);
+    uint32_t even = reader.read(tableLog);
+    uint32_t odd = reader.read(tableLog);
+    uint8_t* out = dst;
+    uint8_t* const end = dst + count;
+    auto decode = [&](uint32_t& state) {
+        const DecodeEntry e = table[state];
+        *out++ = e.symbol;
+        state = e.newState + reader.read(e.nbBits);
+    };
+    while (end - out >= 4 && reader.ptr - reader.start >= 8) {
+        reader.reload();
+        decode(even);
+        decode(odd);
+        decode(even);
+        decode(odd);
+    }
+    while (out < end) {
+        reader.reload();
+        decode(((out - dst) & 1) ? odd : even);
+    }
+    reader.reload();
+    if (reader.ptr != reader.start || reader.consumed != 64 || even != 0 || odd != 0)
+        throw std::runtime_error("Invalid tANS stream: size mismatch");
+    return count;
+}
+
+const EntropyCoder& TANSCoding::entropyCoder() {
+    static const EntropyCoder coder{
+        "tans", compressBound,
+        [](const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCapacity) {
+            return compress(src, srcSize, dst, dstCapacity);
+        },
+        decompressedSize, decompress};
+    return coder;
+}
@@ -0,0 +1,64 @@
+#ifndef TANS_CODING_HPP
+#define TANS_CODING_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include "../common/entropy_coder.h"
+
+// Table-based asymmetric numeral system (tANS) coder, in the style of FSE.
+// Symbol frequencies are normalized to sum to a power of two, 1 << tableLog,
+// and every symbol then costs a fractional number of bits close to its
+// information content, where a Huffman code must round to whole bits.
+//
+// Layout: the symbol count (LEB128 varint), then a mode byte:
+//   MODE_RAW     the bytes follow as they are
+//   MODE_SINGLE  one symbol byte, repeated count times
+//   otherwise    the table log; then the highest symbol present and the
+//                normalized count of each symbol up to it as varints, where
+//                a zero is followed by a byte giving the number of further
+//                zeros; then the bitstream
+// The encoder walks the input backwards and writes bits forwards, ending in
+// its final state and a 1 marker bit, so the decoder reads the bitstream from
+// its end and emits the symbols in order.
+class TANSCoding {
+public:
+    static constexpr unsigned MIN_TABLE_LOG = 5;
+    static constexpr unsigned MAX_TABLE_LOG = 12;
+    static constexpr unsigned DEFAULT_TABLE_LOG = 11;
+    static constexpr uint8_t MODE_RAW = 0;
+    static constexpr uint8_t MODE_SINGLE = 1;
+
+    // In-memory codec over caller-owned buffers; see EntropyCoder. Output
+    // that would not be smaller than the input is stored raw. maxTableLog
+    // trades table size (and so cache use) against precision.
+    static size_t compressBound(size_t srcSize);
+    static size_t compress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCapacity,
+                           unsigned maxTableLog = DEFAULT_TABLE_LOG);
+    static size_t decompressedSize(const uint8_t* src, size_t srcSize);
+    static size_t decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCapacity);
+
+    static const EntropyCoder& entropyCoder();
+
+private:
+    // Decoder state transition: emit symbol, read nbBits, add them to newState.
+    struct DecodeEntry {
+        uint16_t newState;
+        uint8_t symbol;
+        uint8_t nbBits;
+    };
+
+    // Encoder transform of one symbol: the state is shifted right by
+    // (state + deltaNbBits) >> 16 bits and then looked up at deltaFindState.
+    struct EncodeEntry {
+        int32_t deltaFindState;
+        uint32_t deltaNbBits;
+    };
+
+    static unsigned chooseTableLog(size_t srcSize, unsigned symbolsPresent, unsigned maxTableLog);
+    static void normalizeCounts(const uint64_t* counts, size_t total, unsigned tableLog, uint16_t* norm);
+    static void spreadSymbols(const uint16_t* norm, unsigned maxSymbol, unsigned tableLog, uint8_t* tableSymbol);
+    static size_t writeTableHeader(const uint16_t* norm, unsigned maxSymbol, uint8_t* dst);
+    static size_t readTableHeader(const uint8_t* src, size_t srcSize, unsigned tableLog, uint16_t* norm, unsigned& maxSymbol);
+};
+
+#endif
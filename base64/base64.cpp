@@ -1,126 +1,332 @@
 #include "base64.h"
+#include "base64_kernels.h"
+#include "../common/ordered_pipeline.h"
+#include "../common/thread_pool.h"
+#include <algorithm>
 #include <fstream>
-#include <future>
+#include <stdexcept>
 #include <vector>
 
-const size_t chunkSize = 1024 * 1024; // 1MB
-static const std::string b64_chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+static base64_kernels::Alphabet alphabetOf(base64::Variant variant)
+{
+    return variant == base64::Variant::Url ? base64_kernels::Alphabet::Url : base64_kernels::Alphabet::Standard;
+}
+
+static inline bool isSpace(char c)
+{
+    return c == '\n' || c == '\r' || c == ' ' || c == '\t';
+}
+
+// Upper bound on the decoded size of n characters, without looking at them.
+static size_t decodedBound(size_t n)
+{
+    return n / 4 * 3 + 2;
+}
+
+const char *base64::kernelName()
+{
+    return base64_kernels::best().name;
+}
 
-static std::string encode_chunk(const std::vector<unsigned char> &data){
-    std::string out;
-    out.reserve(((data.size() + 2) / 3) * 4);
-    for(size_t i = 0; i < data.size(); i+=3)
+size_t base64::encodedSize(size_t n, Variant variant)
+{
+    if(variant == Variant::Url) return n / 3 * 4 + (n % 3 ? n % 3 + 1 : 0);
+    size_t chars = (n + 2) / 3 * 4;
+    if(variant == Variant::Mime && chars > 0) chars += 2 * ((chars - 1) / MIME_LINE_LENGTH);
+    return chars;
+}
+
+// Characters that are neither whitespace nor padding. Every alphabet
+// character is above ' ', so control characters are skipped wholesale: they
+// are invalid and make decoding throw anyway. Counting in fixed 64-byte
+// blocks lets the compiler vectorize the loop.
+static size_t significantChars(const char *src, size_t n)
+{
+    auto counts = [](char c) { return (static_cast<unsigned char>(c) > ' ') & (c != '='); };
+    size_t significant = 0, i = 0;
+    for(; i + 64 <= n; i += 64)
     {
-        unsigned char a = data[i];
-        unsigned char b = (i + 1 < data.size()) ? data[i+1] : 0;
-        unsigned char c = (i + 2 < data.size()) ? data[i+2] : 0;
-
-        out.push_back(b64_chars[a >> 2]);
-        out.push_back(b64_chars[((a & 0x03) << 4) | (b >> 4)]);
-        out.push_back(i + 1 < data.size() ? b64_chars[((b & 0x0F) << 2) | (c >> 6)] : '=');
-        out.push_back(i + 2 < data.size() ? b64_chars[c & 0x3F] : '=');
+        uint8_t block = 0;
+        for(size_t j = 0; j < 64; j++) block += counts(src[i + j]);
+        significant += block;
     }
-    return out;
+    for(; i < n; i++) significant += counts(src[i]);
+    return significant;
+}
+
+static size_t decodedBytes(size_t significant)
+{
+    size_t rest = significant % 4;
+    return significant / 4 * 3 + (rest > 1 ? rest - 1 : 0);
+}
+
+size_t base64::decodedSize(const char *src, size_t n)
+{
+    return decodedBytes(significantChars(src, n));
 }
 
-void base64::encode(const std::string &inFile, const std::string &outFile, size_t threads)
+size_t base64::Encoder::updateBound(size_t n) const
 {
-    std::ifstream in(inFile, std::ios::binary);
-    std::ofstream out(outFile);
-    if(!in || !out) throw std::runtime_error("File Couldn't be Opened");
+    size_t chars = (pendingSize + n) / 3 * 4;
+    if(variant == Variant::Mime) chars += 2 * ((column + chars) / MIME_LINE_LENGTH);
+    return chars;
+}
 
-    std::vector<std::future<std::string>> futures;
-    while(true)
+// Encodes n bytes (whole groups only) through the kernels. MIME line breaks
+// are written before the first character of the next line rather than after
+// the last one of a full line, so the output never ends with a break.
+char *base64::Encoder::emitGroups(const uint8_t *src, size_t n, char *dst)
+{
+    const base64_kernels::EncodeFn encodeBlocks = base64_kernels::best().encode;
+    const base64_kernels::Alphabet alphabet = alphabetOf(variant);
+    if(variant != Variant::Mime)
     {
-        std::vector<unsigned char> buf(chunkSize);
-        in.read(reinterpret_cast<char*>(buf.data()), buf.size());
-        size_t readBytes = in.gcount();
-        if(readBytes == 0) break;
-        buf.resize(readBytes);
-        futures.push_back(std::async(std::launch::async, encode_chunk, buf));
-
-        if(futures.size() >= threads)
+        encodeBlocks(src, n, dst, alphabet);
+        return dst + n / 3 * 4;
+    }
+    while(n > 0)
+    {
+        if(column == MIME_LINE_LENGTH)
         {
-            out << futures.front().get();
-            futures.erase(futures.begin());
+            *dst++ = '\r';
+            *dst++ = '\n';
+            column = 0;
         }
+        size_t bytes = std::min(n, (MIME_LINE_LENGTH - column) / 4 * 3);
+        encodeBlocks(src, bytes, dst, alphabet);
+        dst += bytes / 3 * 4;
+        column += bytes / 3 * 4;
+        src += bytes;
+        n -= bytes;
     }
-    for(auto& f: futures) out << f.get();
+    return dst;
 }
 
-static inline int b64_index(char c)
+size_t base64::Encoder::update(const uint8_t *src, size_t n, char *dst)
 {
-    auto pos = b64_chars.find(c);
-    return (pos == std::string::npos) ? -1 : static_cast<int>(pos);
+    char *op = dst;
+    if(pendingSize > 0)
+    {
+        while(pendingSize < 3 && n > 0)
+        {
+            pending[pendingSize++] = *src++;
+            n--;
+        }
+        if(pendingSize < 3) return 0;
+        op = emitGroups(pending, 3, op);
+        pendingSize = 0;
+    }
+    size_t whole = n - n % 3;
+    op = emitGroups(src, whole, op);
+    pendingSize = n - whole;
+    for(size_t i = 0; i < pendingSize; i++) pending[i] = src[whole + i];
+    return op - dst;
 }
 
-static std::vector<unsigned char> decode_chunk(const std::string &input)
+size_t base64::Encoder::finish(char *dst)
 {
-    std::vector<unsigned char> out;
-    out.reserve((input.size() / 4) * 3);
-
-    unsigned char a3[3];
-    unsigned char a4[4];
-    size_t i = 0;
+    char *op = dst;
+    if(pendingSize > 0)
+    {
+        if(variant == Variant::Mime && column == MIME_LINE_LENGTH)
+        {
+            *op++ = '\r';
+            *op++ = '\n';
+        }
+        const char *chars = base64_kernels::characters(alphabetOf(variant));
+        uint8_t a = pending[0];
+        uint8_t b = (pendingSize > 1) ? pending[1] : 0;
+        *op++ = chars[a >> 2];
+        *op++ = chars[((a & 0x03) << 4) | (b >> 4)];
+        if(pendingSize > 1) *op++ = chars[(b & 0x0F) << 2];
+        if(variant != Variant::Url)
+            for(size_t i = pendingSize + 1; i < 4; i++) *op++ = '=';
+    }
+    pendingSize = 0;
+    column = 0;
+    return op - dst;
+}
 
-    for(char c : input)
+// Clean runs go through the vector kernels; the loop below only sees quads
+// broken up by whitespace, quads split between calls and the padding.
+size_t base64::Decoder::update(const char *src, size_t n, uint8_t *dst)
+{
+    const base64_kernels::DecodeFn decodeBlocks = base64_kernels::best().decode;
+    const base64_kernels::Alphabet alphabet = alphabetOf(variant);
+    size_t ip = 0, op = 0;
+    while(ip < n)
     {
-        if(c == '=' || b64_index(c) != -1)
+        if(count == 0 && padding == 0)
         {
-            a4[i++] = static_cast<unsigned char>(c);
-            if(i == 4)
-            {
-                int vals[4];
-                for(int k = 0; k<4; k++)
-                    vals[k] = (a4[k] == '=') ? 0 : b64_index(a4[k]);
-                a3[0] = (vals[0] << 2) | ((vals[1] & 0x30) >> 4);
-                a3[1] = ((vals[1] & 0xf) << 4) | ((vals[2] & 0x3c) >> 2);
-                a3[2] = ((vals[2] & 0x3) << 6) | vals[3];
-
-                out.push_back(a3[0]);
-                if(a4[2] != '=') out.push_back(a3[1]);
-                if(a4[3] != '=') out.push_back(a3[2]);
-                i = 0;
-            }
+            size_t used = decodeBlocks(src + ip, n - ip, dst + op, alphabet);
+            ip += used;
+            op += used / 4 * 3;
+            if(ip == n) break;
+        }
+        char c = src[ip++];
+        if(isSpace(c)) continue;
+        if(c == '=')
+        {
+            padding++;
+            continue;
+        }
+        if(padding) throw std::runtime_error("Unexpected data after base64 padding.");
+        quad[count] = base64_kernels::decodeChar(c, alphabet);
+        if(quad[count] < 0) throw std::runtime_error("Invalid character in base64 input.");
+        if(++count == 4)
+        {
+            dst[op++] = static_cast<uint8_t>((quad[0] << 2) | (quad[1] >> 4));
+            dst[op++] = static_cast<uint8_t>(((quad[1] & 0xF) << 4) | (quad[2] >> 2));
+            dst[op++] = static_cast<uint8_t>(((quad[2] & 0x3) << 6) | quad[3]);
+            count = 0;
         }
     }
+    return op;
+}
+
+size_t base64::Decoder::finish(uint8_t *dst)
+{
+    int left = count;
+    size_t pad = padding;
+    count = 0;
+    padding = 0;
+    if(left == 1 || (pad && (left < 2 || left + pad != 4))) throw std::runtime_error("Truncated or misaligned base64 input.");
+    size_t op = 0;
+    if(left >= 2) dst[op++] = static_cast<uint8_t>((quad[0] << 2) | (quad[1] >> 4));
+    if(left == 3) dst[op++] = static_cast<uint8_t>(((quad[1] & 0xF) << 4) | (quad[2] >> 2));
+    return op;
+}
+
+size_t base64::encode(const uint8_t *src, size_t n, char *dst, size_t dstCapacity, Variant variant)
+{
+    if(dstCapacity < encodedSize(n, variant)) throw std::runtime_error("Output buffer too small for base64 output.");
+    Encoder encoder(variant);
+    size_t op = encoder.update(src, n, dst);
+    return op + encoder.finish(dst + op);
+}
+
+size_t base64::decode(const char *src, size_t n, uint8_t *dst, size_t dstCapacity, Variant variant)
+{
+    // No prefix of dstCapacity / 3 * 4 characters can decode to more than
+    // dstCapacity bytes, so only the rest needs counting to find out whether
+    // the output fits. With an exact-size buffer that is a handful of
+    // characters rather than a second pass over the input.
+    Decoder decoder(variant);
+    size_t head = std::min(n, dstCapacity / 3 * 4);
+    size_t op = decoder.update(src, head, dst);
+    if(head < n && dstCapacity - op < decodedBytes(decoder.count + significantChars(src + head, n - head)))
+        throw std::runtime_error("Output buffer too small for decoded base64 data.");
+    op += decoder.update(src + head, n - head, dst + op);
+    return op + decoder.finish(dst + op);
+}
+
+std::string base64::encodeBuffer(const std::vector<unsigned char> &data, Variant variant)
+{
+    std::string out(encodedSize(data.size(), variant), '\0');
+    encode(data.data(), data.size(), &out[0], out.size(), variant);
     return out;
 }
 
-void base64::decode(const std::string &inFile, const std::string &outFile, size_t threads)
+std::vector<unsigned char> base64::decodeBuffer(const std::string &text, Variant variant)
 {
-    std::ifstream in(inFile);
-    std::ofstream out(outFile, std::ios::binary);
-    if (!in || !out) throw std::runtime_error("File open failed");
+    std::vector<unsigned char> out(decodedBound(text.size()));
+    out.resize(decode(text.data(), text.size(), out.data(), out.size(), variant));
+    return out;
+}
 
-    std::vector<std::future<std::vector<unsigned char>>> futures;
-    while(true)
-    {
-        std::string buf(chunkSize, '\0');
-        in.read(&buf[0], buf.size());
-        int bytesRead = in.gcount();
-        if(bytesRead == 0) break;
-        buf.resize(bytesRead);
+static std::ifstream openIn(const std::string &path)
+{
+    std::ifstream in(path, std::ios::binary);
+    if(!in) throw std::runtime_error("Cannot open file : " + path);
+    return in;
+}
 
-        while((buf.size() % 4 != 0) && in) // Don't break a 4-char block
-        {
-            char extra;
-            if(!in.get(extra)) break;
-            buf.push_back(extra);
-        }
+static std::ofstream openOut(const std::string &path)
+{
+    std::ofstream out(path, std::ios::binary);
+    if(!out) throw std::runtime_error("Cannot open file: " + path);
+    return out;
+}
+
+static void readChunk(std::ifstream &in, std::vector<uint8_t> &buf, size_t size)
+{
+    buf.resize(size);
+    in.read(reinterpret_cast<char*>(buf.data()), size);
+    if(in.bad()) throw std::runtime_error("Failed to read input.");
+    buf.resize(in.gcount());
+}
 
-        futures.push_back(std::async(std::launch::async, decode_chunk, buf));
+static void writeChunk(std::ofstream &out, const std::vector<uint8_t> &buf)
+{
+    if(!out.write(reinterpret_cast<const char*>(buf.data()), buf.size()))
+        throw std::runtime_error("Failed to write output.");
+}
+
+void base64::encode(const std::string &inFile, const std::string &outFile, size_t threads, size_t chunkSize, size_t queueDepth)
+{
+    std::ifstream in = openIn(inFile);
+    std::ofstream out = openOut(outFile);
+    // Chunks must hold whole 3-byte groups, or padding would end up in the
+    // middle of the output.
+    chunkSize = std::max<size_t>(3, chunkSize - chunkSize % 3);
+
+    ThreadPool pool(threads);
+    OrderedPipeline(pool, queueDepth).run(
+        [&](std::vector<uint8_t> &buf) { readChunk(in, buf, chunkSize); },
+        [](const std::vector<uint8_t> &data, std::vector<uint8_t> &text) {
+            text.resize(encodedSize(data.size()));
+            encode(data.data(), data.size(), reinterpret_cast<char*>(text.data()), text.size());
+        },
+        [&](const std::vector<uint8_t> &text) { writeChunk(out, text); });
+    out.flush();
+    if(!out) throw std::runtime_error("Failed to write output.");
+}
 
-        if(futures.size() >= threads)
+void base64::decode(const std::string &inFile, const std::string &outFile, size_t threads, size_t chunkSize, size_t queueDepth)
+{
+    std::ifstream in = openIn(inFile);
+    std::ofstream out = openOut(outFile);
+    chunkSize = std::max<size_t>(4, chunkSize);
+
+    // Every chunk but the last must end on a quad boundary. Whitespace does
+    // not count towards quads, so the characters of an unfinished quad are
+    // carried over to the front of the next chunk.
+    std::vector<uint8_t> carry;
+    auto read = [&](std::vector<uint8_t> &buf) {
+        buf.assign(carry.begin(), carry.end());
+        carry.clear();
+        while(true)
         {
-            const auto &decoded = futures.front().get();
-            out.write(reinterpret_cast<const char*>(decoded.data()), decoded.size());
-            futures.erase(futures.begin());
+            size_t kept = buf.size();
+            buf.resize(kept + chunkSize);
+            in.read(reinterpret_cast<char*>(buf.data() + kept), chunkSize);
+            if(in.bad()) throw std::runtime_error("Failed to read input.");
+            buf.resize(kept + in.gcount());
+            if(in.gcount() == 0) return; // end of input: what is left is the last chunk
+
+            size_t significant = 0;
+            for(uint8_t c : buf) significant += !isSpace(static_cast<char>(c));
+            size_t cut = buf.size();
+            for(size_t extra = significant % 4; extra > 0; )
+                if(!isSpace(static_cast<char>(buf[--cut]))) extra--;
+            if(cut > 0)
+            {
+                carry.assign(buf.begin() + cut, buf.end());
+                buf.resize(cut);
+                return;
+            }
+            // Not a single whole quad yet; keep reading.
         }
-    }
-    for(auto &f : futures)
-    {
-        const auto &decoded = f.get();
-        out.write(reinterpret_cast<const char*>(decoded.data()), decoded.size());
-    }
-}
\ No newline at end of file
+    };
+
+    ThreadPool pool(threads);
+    OrderedPipeline(pool, queueDepth).run(
+        read,
+        [](const std::vector<uint8_t> &text, std::vector<uint8_t> &data) {
+            data.resize(decodedBound(text.size()));
+            data.resize(decode(reinterpret_cast<const char*>(text.data()), text.size(), data.data(), data.size()));
+        },
+        [&](const std::vector<uint8_t> &data) { writeChunk(out, data); });
+    out.flush();
+    if(!out) throw std::runtime_error("Failed to write output.");
+}
@@ -1,11 +1,100 @@
 #ifndef BASE64_H
 #define BASE64_H
+#include <cstdint>
 #include <string>
 #include <vector>
 
 class base64 {
 public:
-    static void encode(const std::string &inFile, const std::string &outFile, size_t threads);
-    static void decode(const std::string &inFile, const std::string &outFile, size_t threads);
+    static constexpr size_t DEFAULT_CHUNK_SIZE = 1 << 20; // 1MB
+    static constexpr size_t MIME_LINE_LENGTH = 76;
+
+    // Standard: RFC 4648 alphabet with '=' padding.
+    // Url: RFC 4648 section 5 alphabet ('-' and '_'), without padding.
+    // Mime: standard alphabet and padding, split into lines of
+    // MIME_LINE_LENGTH characters joined by CRLF (RFC 2045).
+    // Decoding skips whitespace and accepts padding in every variant.
+    enum class Variant { Standard, Url, Mime };
+
+    // Exact number of characters encode() writes for n bytes.
+    static size_t encodedSize(size_t n, Variant variant = Variant::Standard);
+    // Exact number of bytes decode() writes for valid input; a scan that
+    // counts the characters that are neither whitespace nor padding.
+    static size_t decodedSize(const char *src, size_t n);
+
+    // In-memory coding straight into the caller's buffer. Both return the
+    // size written and throw if dstCapacity is below the exact size.
+    static size_t encode(const uint8_t *src, size_t n, char *dst, size_t dstCapacity,
+                         Variant variant = Variant::Standard);
+    static size_t decode(const char *src, size_t n, uint8_t *dst, size_t dstCapacity,
+                         Variant variant = Variant::Standard);
+
+    static std::string encodeBuffer(const std::vector<unsigned char> &data, Variant variant = Variant::Standard);
+    static std::vector<unsigned char> decodeBuffer(const std::string &text, Variant variant = Variant::Standard);
+
+    // Incremental encoder: input may be split anywhere, and the output is
+    // the same as encode() over the concatenation.
+    class Encoder
+    {
+    public:
+        // Most characters finish() writes: a line break and a padded group.
+        static constexpr size_t FINISH_BOUND = 6;
+
+        explicit Encoder(Variant variant = Variant::Standard) : variant(variant) {}
+
+        // Most characters the next update() of n bytes writes.
+        size_t updateBound(size_t n) const;
+        // Encodes the whole groups available so far into dst and keeps the
+        // last one or two bytes for later. Returns the characters written.
+        size_t update(const uint8_t *src, size_t n, char *dst);
+        // Writes the final partial group and resets for a new stream.
+        size_t finish(char *dst);
+
+    private:
+        char *emitGroups(const uint8_t *src, size_t n, char *dst);
+
+        Variant variant;
+        uint8_t pending[3];
+        size_t pendingSize = 0;
+        size_t column = 0; // characters on the current MIME line
+    };
+
+    // Incremental decoder: input may be split anywhere, including inside a
+    // quad or between padding characters.
+    class Decoder
+    {
+    public:
+        explicit Decoder(Variant variant = Variant::Standard) : variant(variant) {}
+
+        // Most bytes the next update() of n characters writes.
+        static size_t updateBound(size_t n) { return (n + 3) / 4 * 3; }
+        // Decodes every complete quad into dst and keeps the characters of
+        // an unfinished one. Returns the bytes written; throws on invalid
+        // characters and on data after padding.
+        size_t update(const char *src, size_t n, uint8_t *dst);
+        // Writes the bytes of a final short group (at most 2), checks that
+        // the input ended on a group boundary and resets for a new stream.
+        size_t finish(uint8_t *dst);
+
+    private:
+        friend class base64;
+
+        Variant variant;
+        int quad[4];
+        int count = 0;
+        size_t padding = 0;
+    };
+
+    // File to file on a pool of threads (0 = one per hardware thread). The
+    // input is read and the output written on their own threads while the
+    // pool works; at most queueDepth chunks (0 = twice the thread count) of
+    // chunkSize bytes are held in memory at once.
+    static void encode(const std::string &inFile, const std::string &outFile, size_t threads,
+                       size_t chunkSize = DEFAULT_CHUNK_SIZE, size_t queueDepth = 0);
+    static void decode(const std::string &inFile, const std::string &outFile, size_t threads,
+                       size_t chunkSize = DEFAULT_CHUNK_SIZE, size_t queueDepth = 0);
+
+    // Kernel set picked for this CPU: "avx512vbmi", "avx2", "ssse3" or "scalar".
+    static const char *kernelName();
 };
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,341 @@
+#include "base64_kernels.h"
+#include <cstring>
+#if BASE64_X86
+#include <immintrin.h>
+#endif
+
+namespace base64_kernels
+{
+
+const char *characters(Alphabet alphabet)
+{
+    return alphabet == Alphabet::Url ? "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_"
+                                     : "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+}
+
+namespace
+{
+
+// Two output characters for every 12-bit value, so a group takes two lookups.
+struct EncodeTable
+{
+    char pairs[4096][2];
+    explicit EncodeTable(Alphabet alphabet)
+    {
+        const char *chars = characters(alphabet);
+        for(int i = 0; i < 4096; i++)
+        {
+            pairs[i][0] = chars[i >> 6];
+            pairs[i][1] = chars[i & 63];
+        }
+    }
+};
+
+// Each character's value pre-shifted to its place in the 24-bit group.
+// Characters outside the alphabet set bits above it, so one test over the
+// OR of four lookups validates a whole quad.
+struct DecodeTables
+{
+    static constexpr uint32_t INVALID = 0xFF000000;
+    uint32_t shifted[4][256];
+    explicit DecodeTables(Alphabet alphabet)
+    {
+        for(int k = 0; k < 4; k++)
+            for(int c = 0; c < 256; c++) shifted[k][c] = INVALID;
+        const char *chars = characters(alphabet);
+        for(uint32_t v = 0; v < 64; v++)
+        {
+            unsigned char c = static_cast<unsigned char>(chars[v]);
+            shifted[0][c] = v << 18;
+            shifted[1][c] = v << 12;
+            shifted[2][c] = v << 6;
+            shifted[3][c] = v;
+        }
+    }
+};
+
+const EncodeTable &encodeTable(Alphabet alphabet)
+{
+    static const EncodeTable standard(Alphabet::Standard), url(Alphabet::Url);
+    return alphabet == Alphabet::Url ? url : standard;
+}
+
+const DecodeTables &decodeTables(Alphabet alphabet)
+{
+    static const DecodeTables standard(Alphabet::Standard), url(Alphabet::Url);
+    return alphabet == Alphabet::Url ? url : standard;
+}
+
+} // namespace
+
+size_t encodeScalar(const uint8_t *src, size_t n, char *dst, Alphabet alphabet)
+{
+    const EncodeTable &table = encodeTable(alphabet);
+    size_t whole = n - n % 3;
+    for(size_t i = 0; i < whole; i += 3)
+    {
+        uint32_t group = (uint32_t(src[i]) << 16) | (uint32_t(src[i + 1]) << 8) | src[i + 2];
+        std::memcpy(dst, table.pairs[group >> 12], 2);
+        std::memcpy(dst + 2, table.pairs[group & 0xFFF], 2);
+        dst += 4;
+    }
+    return whole;
+}
+
+size_t decodeScalar(const char *src, size_t n, uint8_t *dst, Alphabet alphabet)
+{
+    const DecodeTables &tables = decodeTables(alphabet);
+    const unsigned char *s = reinterpret_cast<const unsigned char *>(src);
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4)
+    {
+        uint32_t group = tables.shifted[0][s[i]] | tables.shifted[1][s[i + 1]] |
+                         tables.shifted[2][s[i + 2]] | tables.shifted[3][s[i + 3]];
+        if(group & DecodeTables::INVALID) break;
+        dst[0] = static_cast<uint8_t>(group >> 16);
+        dst[1] = static_cast<uint8_t>(group >> 8);
+        dst[2] = static_cast<uint8_t>(group);
+        dst += 3;
+    }
+    return i;
+}
+
+int decodeChar(char c, Alphabet alphabet)
+{
+    uint32_t v = decodeTables(alphabet).shifted[3][static_cast<unsigned char>(c)];
+    return (v & DecodeTables::INVALID) ? -1 : static_cast<int>(v);
+}
+
+#if BASE64_X86
+
+// The vector kernels follow Muła and Lemire, "Faster Base64 Encoding and
+// Decoding Using AVX2 Instructions" (2018) and its AVX-512 VBMI follow-up.
+// Each one handles the bulk of the input and leaves the rest to the scalar
+// kernel, including any quad it refused.
+
+// Spreads 12 bytes over four 32-bit lanes as [b1 b0 b2 b1] and pulls out the
+// four 6-bit indices of each lane with two multiplies.
+__attribute__((target("ssse3")))
+static inline __m128i encodeIndices128(__m128i in)
+{
+    in = _mm_shuffle_epi8(in, _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+    __m128i t0 = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0FC0FC00)), _mm_set1_epi32(0x04000040));
+    __m128i t1 = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003F03F0)), _mm_set1_epi32(0x01000010));
+    return _mm_or_si128(t0, t1);
+}
+
+// Offset from each 6-bit range to its characters; only 62 and 63 differ
+// between the alphabets.
+__attribute__((target("ssse3")))
+static inline __m128i encodeOffsets128(Alphabet alphabet)
+{
+    const char *chars = characters(alphabet);
+    return _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                         '0' - 52, '0' - 52, '0' - 52, static_cast<char>(chars[62] - 62), static_cast<char>(chars[63] - 63), 'A', 0, 0);
+}
+
+// Maps 6-bit indices to ASCII by adding a per-range offset picked with pshufb.
+__attribute__((target("ssse3")))
+static inline __m128i encodeLookup128(__m128i indices, __m128i offsets)
+{
+    __m128i range = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+    __m128i upper = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+    range = _mm_or_si128(range, _mm_and_si128(upper, _mm_set1_epi8(13)));
+    return _mm_add_epi8(_mm_shuffle_epi8(offsets, range), indices);
+}
+
+__attribute__((target("ssse3")))
+size_t encodeSSSE3(const uint8_t *src, size_t n, char *dst, Alphabet alphabet)
+{
+    const __m128i offsets = encodeOffsets128(alphabet);
+    size_t i = 0;
+    for(; i + 16 <= n; i += 12, dst += 16) // reads 16 bytes, consumes 12
+    {
+        __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), encodeLookup128(encodeIndices128(in), offsets));
+    }
+    return i + encodeScalar(src + i, n - i, dst, alphabet);
+}
+
+// Classifies every character by its nibbles: lo & hi is non-zero exactly for
+// bytes outside the alphabet, and the high nibble picks the offset that turns
+// a valid character into its 6-bit value. The one character whose offset
+// differs from the rest of its column ('/' or '_') moves its index by
+// adjust.
+struct DecodeLUT128
+{
+    __m128i lo, hi, roll, special, adjust;
+};
+
+__attribute__((target("ssse3")))
+static inline DecodeLUT128 decodeLUT128(Alphabet alphabet)
+{
+    if(alphabet == Alphabet::Url)
+        return {_mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x3B, 0x3B, 0x3A, 0x3B, 0x33),
+                _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x20, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10),
+                _mm_setr_epi8(0, 0, 17, 4, -65, -65, -71, -71, 0, 0, 0, -32, 0, 0, 0, 0),
+                _mm_set1_epi8(0x5F), _mm_set1_epi8(6)};
+    return {_mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A),
+            _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10),
+            _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0),
+            _mm_set1_epi8(0x2F), _mm_set1_epi8(-1)};
+}
+
+__attribute__((target("ssse3")))
+size_t decodeSSSE3(const char *src, size_t n, uint8_t *dst, Alphabet alphabet)
+{
+    const DecodeLUT128 lut = decodeLUT128(alphabet);
+    const __m128i mask2F = _mm_set1_epi8(0x2F);
+    const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16, dst += 12)
+    {
+        __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        __m128i hiNibbles = _mm_and_si128(_mm_srli_epi32(in, 4), mask2F);
+        __m128i hi = _mm_shuffle_epi8(lut.hi, hiNibbles);
+        __m128i lo = _mm_shuffle_epi8(lut.lo, _mm_and_si128(in, mask2F));
+        if(_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128()))) break;
+        __m128i moved = _mm_and_si128(_mm_cmpeq_epi8(in, lut.special), lut.adjust);
+        __m128i roll = _mm_shuffle_epi8(lut.roll, _mm_add_epi8(moved, hiNibbles));
+        __m128i values = _mm_add_epi8(in, roll);
+        // Merge four 6-bit values per lane into 24 bits, then drop the gaps.
+        __m128i merged = _mm_madd_epi16(_mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140)), _mm_set1_epi32(0x00011000));
+        __m128i out = _mm_shuffle_epi8(merged, pack);
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(dst), out);
+        uint32_t tail = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_srli_si128(out, 8)));
+        std::memcpy(dst + 8, &tail, 4);
+    }
+    return i + decodeScalar(src + i, n - i, dst, alphabet);
+}
+
+__attribute__((target("avx2")))
+size_t encodeAVX2(const uint8_t *src, size_t n, char *dst, Alphabet alphabet)
+{
+    const __m256i shuffle = _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+                                             1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+    const __m256i offsets = _mm256_broadcastsi128_si256(encodeOffsets128(alphabet));
+    size_t i = 0;
+    for(; i + 28 <= n; i += 24, dst += 32) // reads 28 bytes, consumes 24
+    {
+        __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i + 12));
+        __m256i in = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+        in = _mm256_shuffle_epi8(in, shuffle);
+        __m256i t0 = _mm256_mulhi_epu16(_mm256_and_si256(in, _mm256_set1_epi32(0x0FC0FC00)), _mm256_set1_epi32(0x04000040));
+        __m256i t1 = _mm256_mullo_epi16(_mm256_and_si256(in, _mm256_set1_epi32(0x003F03F0)), _mm256_set1_epi32(0x01000010));
+        __m256i indices = _mm256_or_si256(t0, t1);
+        __m256i range = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+        __m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+        range = _mm256_or_si256(range, _mm256_and_si256(upper, _mm256_set1_epi8(13)));
+        __m256i out = _mm256_add_epi8(_mm256_shuffle_epi8(offsets, range), indices);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst), out);
+    }
+    return i + encodeSSSE3(src + i, n - i, dst, alphabet);
+}
+
+__attribute__((target("avx2")))
+size_t decodeAVX2(const char *src, size_t n, uint8_t *dst, Alphabet alphabet)
+{
+    const DecodeLUT128 lut = decodeLUT128(alphabet);
+    const __m256i lutLo = _mm256_broadcastsi128_si256(lut.lo);
+    const __m256i lutHi = _mm256_broadcastsi128_si256(lut.hi);
+    const __m256i lutRoll = _mm256_broadcastsi128_si256(lut.roll);
+    const __m256i special = _mm256_broadcastsi128_si256(lut.special);
+    const __m256i adjust = _mm256_broadcastsi128_si256(lut.adjust);
+    const __m256i mask2F = _mm256_set1_epi8(0x2F);
+    const __m256i pack = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                          2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    const __m256i gather = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+    size_t i = 0;
+    for(; i + 32 <= n; i += 32, dst += 24)
+    {
+        __m256i in = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+        __m256i hiNibbles = _mm256_and_si256(_mm256_srli_epi32(in, 4), mask2F);
+        __m256i hi = _mm256_shuffle_epi8(lutHi, hiNibbles);
+        __m256i lo = _mm256_shuffle_epi8(lutLo, _mm256_and_si256(in, mask2F));
+        if(!_mm256_testz_si256(lo, hi)) break;
+        __m256i moved = _mm256_and_si256(_mm256_cmpeq_epi8(in, special), adjust);
+        __m256i roll = _mm256_shuffle_epi8(lutRoll, _mm256_add_epi8(moved, hiNibbles));
+        __m256i values = _mm256_add_epi8(in, roll);
+        __m256i merged = _mm256_madd_epi16(_mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140)), _mm256_set1_epi32(0x00011000));
+        __m256i out = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(merged, pack), gather);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), _mm256_castsi256_si128(out));
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + 16), _mm256_extracti128_si256(out, 1));
+    }
+    return i + decodeSSSE3(src + i, n - i, dst, alphabet);
+}
+
+__attribute__((target("avx512f,avx512bw,avx512vbmi")))
+size_t encodeAVX512VBMI(const uint8_t *src, size_t n, char *dst, Alphabet alphabet)
+{
+    // Same [b1 b0 b2 b1] layout as above; multishift then extracts each
+    // 6-bit field and a 64-entry permute does the whole alphabet lookup.
+    const __m512i spread = _mm512_setr_epi32(0x01020001, 0x04050304, 0x07080607, 0x0A0B090A, 0x0D0E0C0D, 0x10110F10,
+                                             0x13141213, 0x16171516, 0x191A1819, 0x1C1D1B1C, 0x1F201E1F, 0x22232122,
+                                             0x25262425, 0x28292728, 0x2B2C2A2B, 0x2E2F2D2E);
+    const __m512i shifts = _mm512_set1_epi64(0x3036242A1016040A);
+    const __m512i chars = _mm512_loadu_si512(characters(alphabet));
+    size_t i = 0;
+    for(; i + 64 <= n; i += 48, dst += 64) // reads 64 bytes, consumes 48
+    {
+        __m512i in = _mm512_permutexvar_epi8(spread, _mm512_loadu_si512(src + i));
+        __m512i indices = _mm512_multishift_epi64_epi8(shifts, in);
+        _mm512_storeu_si512(dst, _mm512_permutexvar_epi8(indices, chars));
+    }
+    return i + encodeAVX2(src + i, n - i, dst, alphabet);
+}
+
+__attribute__((target("avx512f,avx512bw,avx512vbmi")))
+size_t decodeAVX512VBMI(const char *src, size_t n, uint8_t *dst, Alphabet alphabet)
+{
+    // 128-entry ASCII table split over two registers; invalid entries and
+    // non-ASCII input both show up as a set top bit.
+    struct Table
+    {
+        alignas(64) uint8_t values[128];
+        explicit Table(Alphabet alphabet)
+        {
+            std::memset(values, 0x80, sizeof(values));
+            const char *chars = characters(alphabet);
+            for(uint8_t v = 0; v < 64; v++) values[static_cast<unsigned char>(chars[v])] = v;
+        }
+    };
+    static const Table standard(Alphabet::Standard), url(Alphabet::Url);
+    const uint8_t *table = (alphabet == Alphabet::Url ? url : standard).values;
+    // Byte 3k+j of the output is byte 4k+2-j of the merged 24-bit lanes.
+    alignas(64) static const uint8_t pack[64] = {
+        2,  1,  0,  6,  5,  4,  10, 9,  8,  14, 13, 12, 18, 17, 16, 22, 21, 20, 26, 25, 24, 30, 29, 28,
+        34, 33, 32, 38, 37, 36, 42, 41, 40, 46, 45, 44, 50, 49, 48, 54, 53, 52, 58, 57, 56, 62, 61, 60};
+    const __m512i lookupLo = _mm512_load_si512(table);
+    const __m512i lookupHi = _mm512_load_si512(table + 64);
+    const __m512i packIndex = _mm512_load_si512(pack);
+    size_t i = 0;
+    for(; i + 64 <= n; i += 64, dst += 48)
+    {
+        __m512i in = _mm512_loadu_si512(src + i);
+        __m512i values = _mm512_permutex2var_epi8(lookupLo, in, lookupHi);
+        if(_mm512_movepi8_mask(_mm512_or_si512(values, in))) break;
+        __m512i merged = _mm512_madd_epi16(_mm512_maddubs_epi16(values, _mm512_set1_epi32(0x01400140)), _mm512_set1_epi32(0x00011000));
+        _mm512_mask_storeu_epi8(dst, 0x0000FFFFFFFFFFFFULL, _mm512_permutexvar_epi8(packIndex, merged));
+    }
+    return i + decodeAVX2(src + i, n - i, dst, alphabet);
+}
+
+#endif // BASE64_X86
+
+const Kernels &best()
+{
+    static const Kernels kernels = [] {
+#if BASE64_X86
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx512vbmi") && __builtin_cpu_supports("avx512bw"))
+            return Kernels{"avx512vbmi", encodeAVX512VBMI, decodeAVX512VBMI};
+        if(__builtin_cpu_supports("avx2")) return Kernels{"avx2", encodeAVX2, decodeAVX2};
+        if(__builtin_cpu_supports("ssse3")) return Kernels{"ssse3", encodeSSSE3, decodeSSSE3};
+#endif
+        return Kernels{"scalar", encodeScalar, decodeScalar};
+    }();
+    return kernels;
+}
+
+} // namespace base64_kernels
@@ -0,0 +1,56 @@
+#ifndef BASE64_KERNELS_H
+#define BASE64_KERNELS_H
+#include <cstddef>
+#include <cstdint>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define BASE64_X86 1
+#else
+#define BASE64_X86 0
+#endif
+
+// Bulk base64 kernels over whole groups only: 3 input bytes when encoding, 4
+// alphabet characters when decoding. Padding, whitespace and error reporting
+// are left to base64.cpp. Every kernel writes exactly the bytes it produces,
+// so the output buffers need no slack.
+namespace base64_kernels
+{
+    // Standard: RFC 4648 "+/". Url: RFC 4648 section 5 "-_".
+    enum class Alphabet { Standard, Url };
+
+    // Encodes the leading n / 3 groups of src into dst (4 characters each) and
+    // returns the number of input bytes consumed.
+    using EncodeFn = size_t (*)(const uint8_t *src, size_t n, char *dst, Alphabet alphabet);
+    // Decodes leading quads of alphabet characters into dst (3 bytes each) and
+    // stops before the first quad holding anything else: padding, whitespace
+    // or an invalid character. Returns the number of characters consumed.
+    using DecodeFn = size_t (*)(const char *src, size_t n, uint8_t *dst, Alphabet alphabet);
+
+    // The 64 characters of an alphabet, in value order.
+    const char *characters(Alphabet alphabet);
+    // 6-bit value of c, or -1 if c is not in the alphabet.
+    int decodeChar(char c, Alphabet alphabet);
+
+    size_t encodeScalar(const uint8_t *src, size_t n, char *dst, Alphabet alphabet);
+    size_t decodeScalar(const char *src, size_t n, uint8_t *dst, Alphabet alphabet);
+
+#if BASE64_X86
+    size_t encodeSSSE3(const uint8_t *src, size_t n, char *dst, Alphabet alphabet);
+    size_t decodeSSSE3(const char *src, size_t n, uint8_t *dst, Alphabet alphabet);
+    size_t encodeAVX2(const uint8_t *src, size_t n, char *dst, Alphabet alphabet);
+    size_t decodeAVX2(const char *src, size_t n, uint8_t *dst, Alphabet alphabet);
+    size_t encodeAVX512VBMI(const uint8_t *src, size_t n, char *dst, Alphabet alphabet);
+    size_t decodeAVX512VBMI(const char *src, size_t n, uint8_t *dst, Alphabet alphabet);
+#endif
+
+    struct Kernels
+    {
+        const char *name;
+        EncodeFn encode;
+        DecodeFn decode;
+    };
+
+    // The fastest kernels this CPU supports, detected once with CPUID.
+    const Kernels &best();
+}
+#endif
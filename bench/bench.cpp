@@ -0,0 +1,446 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "../lz4/lz4.h"
+#include "../lz4/lz4frame.h"
+#include "../lz4/lz4stream.h"
+#include "../base64/base64.h"
+#include "../HuffmanCoding/HuffmanCoding.hpp"
+#include "../TANSCoding/TANSCoding.hpp"
+
+// In-memory benchmark for every codec in the tree. Each (codec, corpus) pair
+// runs in a forked child, so the peak RSS it reports belongs to that pair
+// alone and one codec's allocations cannot inflate the next one's numbers.
+//
+// Build: g++ -O2 -std=c++17 -pthread bench/bench.cpp lz4/lz4.cpp lz4/lz4dict.cpp lz4/lz4frame.cpp
+//        lz4/lz4entropy.cpp lz4/lz4stream.cpp base64/base64.cpp base64/base64_kernels.cpp HuffmanCoding/HuffmanCoding.cpp
+//        TANSCoding/TANSCoding.cpp -o bench
+
+namespace {
+
+constexpr size_t DEFAULT_CORPUS_SIZE = 4 << 20; // 4MB
+constexpr int DEFAULT_ITERATIONS = 5;
+
+struct Corpus
+{
+    std::string name;
+    std::string path; // empty for the built-in corpora
+};
+
+struct Result
+{
+    bool ok = false;
+    char error[128] = {};
+    uint64_t inputSize = 0;
+    uint64_t outputSize = 0;
+    double compressSeconds = 0;   // best over all iterations
+    double decompressSeconds = 0; // best over all iterations
+    long peakRssKb = 0;
+};
+
+// Roughly English prose: common words drawn with a skewed distribution.
+std::vector<uint8_t> makeText(size_t size, std::mt19937_64 &rng)
+{
+    static const char *words[] = {
+        "the", "of", "and", "to", "in", "a", "is", "that", "for", "it", "as", "was", "with", "be", "by",
+        "on", "not", "he", "this", "are", "or", "his", "from", "at", "which", "but", "have", "an", "had",
+        "they", "you", "were", "their", "one", "all", "we", "can", "her", "has", "there", "been", "if",
+        "more", "when", "will", "would", "who", "so", "no", "compression", "block", "stream", "window",
+        "dictionary", "literal", "match", "offset", "entropy", "symbol", "frequency", "table"};
+    const size_t wordCount = sizeof(words) / sizeof(words[0]);
+    std::vector<uint8_t> out;
+    out.reserve(size);
+    size_t sentence = 0;
+    while (out.size() < size) {
+        // Squaring a uniform draw favours the short, frequent words at the front.
+        double u = std::generate_canonical<double, 32>(rng);
+        const char *word = words[static_cast<size_t>(u * u * wordCount)];
+        out.insert(out.end(), word, word + std::strlen(word));
+        if (++sentence % 12 == 0) {
+            out.push_back('.');
+            out.push_back(sentence % 60 == 0 ? '\n' : ' ');
+        } else {
+            out.push_back(' ');
+        }
+    }
+    out.resize(size);
+    return out;
+}
+
+std::vector<uint8_t> makeRandom(size_t size, std::mt19937_64 &rng)
+{
+    std::vector<uint8_t> out(size);
+    for (size_t i = 0; i < size; i += 8) {
+        uint64_t v = rng();
+        std::memcpy(out.data() + i, &v, std::min<size_t>(8, size - i));
+    }
+    return out;
+}
+
+// One random chunk repeated, like a backup stream holding several copies of
+// the same encrypted or already-compressed file: no byte-level redundancy,
+// but every copy after the first is one long match. The chunk fits the 64KB
+// window and its length does not divide the block size.
+std::vector<uint8_t> makeRepeatedRandom(size_t size, std::mt19937_64 &rng)
+{
+    std::vector<uint8_t> chunk = makeRandom(30001, rng);
+    std::vector<uint8_t> out;
+    out.reserve(size + chunk.size());
+    while (out.size() < size) out.insert(out.end(), chunk.begin(), chunk.end());
+    out.resize(size);
+    return out;
+}
+
+// Log-like lines built from a few templates with changing counters, so long
+// matches are everywhere but the data is not a single repeated block.
+std::vector<uint8_t> makeRepetitive(size_t size, std::mt19937_64 &rng)
+{
+    static const char *templates[] = {
+        "INFO  request served path=/api/v1/items status=200 bytes=",
+        "DEBUG cache lookup key=user:session hit=true latency_us=",
+        "WARN  slow query table=orders rows_scanned=",
+        "INFO  heartbeat from worker node-",
+    };
+    std::vector<uint8_t> out;
+    out.reserve(size);
+    uint64_t line = 0;
+    while (out.size() < size) {
+        const char *t = templates[rng() % 4];
+        std::string s = std::to_string(1700000000 + line++) + " " + t + std::to_string(rng() % 1000) + "\n";
+        out.insert(out.end(), s.begin(), s.end());
+    }
+    out.resize(size);
+    return out;
+}
+
+// Fixed-size little-endian records: an incrementing id, a small enum, a
+// slowly drifting float and padding, like a typical telemetry dump.
+std::vector<uint8_t> makeBinary(size_t size, std::mt19937_64 &rng)
+{
+    std::vector<uint8_t> out;
+    out.reserve(size + 32);
+    uint32_t id = 0;
+    float reading = 20.0f;
+    std::normal_distribution<float> drift(0.0f, 0.05f);
+    while (out.size() < size) {
+        uint8_t record[24] = {};
+        uint16_t kind = static_cast<uint16_t>(rng() % 5);
+        reading += drift(rng);
+        uint64_t timestamp = 1700000000000ULL + uint64_t(id) * 10;
+        std::memcpy(record, &id, 4);
+        std::memcpy(record + 4, &kind, 2);
+        std::memcpy(record + 8, &reading, 4);
+        std::memcpy(record + 12, &timestamp, 8);
+        out.insert(out.end(), record, record + sizeof(record));
+        ++id;
+    }
+    out.resize(size);
+    return out;
+}
+
+std::vector<uint8_t> loadCorpus(const Corpus &corpus, size_t size)
+{
+    if (!corpus.path.empty()) {
+        std::ifstream in(corpus.path, std::ios::binary);
+        if (!in) throw std::runtime_error("Cannot open file : " + corpus.path);
+        return std::vector<uint8_t>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    std::mt19937_64 rng(12345); // fixed seed, so runs are comparable
+    if (corpus.name == "text") return makeText(size, rng);
+    if (corpus.name == "random") return makeRandom(size, rng);
+    if (corpus.name == "repetitive") return makeRepetitive(size, rng);
+    if (corpus.name == "dup-random") return makeRepeatedRandom(size, rng);
+    return makeBinary(size, rng);
+}
+
+// A codec under test works on preallocated buffers and returns the number of
+// bytes it wrote, so the timed region holds no I/O.
+struct Codec
+{
+    std::string name;
+    std::function<size_t(const std::vector<uint8_t> &in, std::vector<uint8_t> &out)> compress;
+    std::function<size_t(const std::vector<uint8_t> &in, size_t inSize, std::vector<uint8_t> &out, size_t outSize)> decompress;
+};
+
+std::vector<Codec> makeCodecs()
+{
+    std::vector<Codec> codecs;
+    for (SimpleLZ4::Level level : {SimpleLZ4::Level::Fast, SimpleLZ4::Level::High}) {
+        codecs.push_back({level == SimpleLZ4::Level::Fast ? "lz4-fast" : "lz4-high",
+            [level](const std::vector<uint8_t> &in, std::vector<uint8_t> &out) {
+                out.resize(SimpleLZ4::compressBound(in.size()));
+                return SimpleLZ4(level).compress(in.data(), in.size(), out.data(), out.size());
+            },
+            [](const std::vector<uint8_t> &in, size_t inSize, std::vector<uint8_t> &out, size_t outSize) {
+                out.resize(outSize);
+                return SimpleLZ4::decompressBlock(in.data(), inSize, out.data(), out.size());
+            }});
+    }
+    codecs.push_back({"lz4-large",
+        [](const std::vector<uint8_t> &in, std::vector<uint8_t> &out) {
+            out.resize(SimpleLZ4::compressBound(in.size()));
+            return SimpleLZ4(SimpleLZ4::Level::Fast, SimpleLZ4::Profile::Large).compress(in.data(), in.size(), out.data(), out.size());
+        },
+        [](const std::vector<uint8_t> &in, size_t inSize, std::vector<uint8_t> &out, size_t outSize) {
+            out.resize(outSize);
+            return SimpleLZ4::decompressBlock(in.data(), inSize, out.data(), out.size());
+        }});
+    // A frame of independent blocks compressed against a dictionary, read
+    // back through the incremental decoder, which has to hand every block
+    // the dictionary rather than the previous block's output.
+    static const LZ4Dictionary dictionary = [] {
+        std::mt19937_64 rng(54321);
+        return LZ4Dictionary(makeText(LZ4Dictionary::DEFAULT_TRAINED_SIZE, rng));
+    }();
+    LZ4Frame::Options dictOptions;
+    dictOptions.threads = 1;
+    dictOptions.dictionary = &dictionary;
+    codecs.push_back({"lz4-dict",
+        [dictOptions](const std::vector<uint8_t> &in, std::vector<uint8_t> &out) {
+            out.resize(LZ4Frame::compressBound(in.size(), dictOptions));
+            return LZ4Frame::compress(in.data(), in.size(), out.data(), out.size(), dictOptions);
+        },
+        [](const std::vector<uint8_t> &in, size_t inSize, std::vector<uint8_t> &out, size_t outSize) {
+            out.resize(outSize);
+            LZ4StreamDecoder decoder(&dictionary);
+            size_t written = 0;
+            for (size_t pos = 0; pos < inSize; pos += 1 << 16) {
+                decoder.push(in.data() + pos, std::min<size_t>(1 << 16, inSize - pos));
+                while (decoder.available()) {
+                    if (written == out.size()) throw std::runtime_error("stream decoded past the expected size");
+                    written += decoder.pull(out.data() + written, out.size() - written);
+                }
+            }
+            if (!decoder.finished()) throw std::runtime_error("stream ended early");
+            return written;
+        }});
+    // High-level matching plus the entropy stage, on one thread.
+    LZ4Frame::Options entropyOptions;
+    entropyOptions.threads = 1;
+    entropyOptions.level = SimpleLZ4::Level::High;
+    entropyOptions.entropy = true;
+    codecs.push_back({"lz4-huff",
+        [entropyOptions](const std::vector<uint8_t> &in, std::vector<uint8_t> &out) {
+            out.resize(LZ4Frame::compressBound(in.size(), entropyOptions));
+            return LZ4Frame::compress(in.data(), in.size(), out.data(), out.size(), entropyOptions);
+        },
+        [](const std::vector<uint8_t> &in, size_t inSize, std::vector<uint8_t> &out, size_t outSize) {
+            out.resize(outSize);
+            return LZ4Frame::decompress(in.data(), inSize, out.data(), out.size(), 1);
+        }});
+    codecs.push_back({"base64",
+        [](const std::vector<uint8_t> &in, std::vector<uint8_t> &out) {
+            out.resize(base64::encodedSize(in.size()));
+            return base64::encode(in.data(), in.size(), reinterpret_cast<char *>(out.data()), out.size());
+        },
+        [](const std::vector<uint8_t> &in, size_t inSize, std::vector<uint8_t> &out, size_t outSize) {
+            out.resize(outSize);
+            return base64::decode(reinterpret_cast<const char *>(in.data()), inSize, out.data(), out.size());
+        }});
+    codecs.push_back({"huffman",
+        [](const std::vector<uint8_t> &in, std::vector<uint8_t> &out) {
+            out.resize(HuffmanCoding::compressBound(in.size()));
+            HuffmanCoding huffman;
+            return huffman.compress(in.data(), in.size(), out.data(), out.size());
+        },
+        [](const std::vector<uint8_t> &in, size_t inSize, std::vector<uint8_t> &out, size_t outSize) {
+            out.resize(outSize);
+            HuffmanCoding huffman;
+            return huffman.decompress(in.data(), inSize, out.data(), out.size());
+        }});
+    codecs.push_back({"tans",
+        [](const std::vector<uint8_t> &in, std::vector<uint8_t> &out) {
+            out.resize(TANSCoding::compressBound(in.size()));
+            return TANSCoding::compress(in.data(), in.size(), out.data(), out.size());
+        },
+        [](const std::vector<uint8_t> &in, size_t inSize, std::vector<uint8_t> &out, size_t outSize) {
+            out.resize(outSize);
+            return TANSCoding::decompress(in.data(), inSize, out.data(), out.size());
+        }});
+    return codecs;
+}
+
+template <typename F>
+double timeBest(int iterations, F &&run)
+{
+    double best = 0;
+    for (int i = 0; i < iterations; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        run();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (i == 0 || seconds < best) best = seconds;
+    }
+    return best;
+}
+
+Result runOne(const Codec &codec, const Corpus &corpus, size_t size, int iterations)
+{
+    Result result;
+    std::vector<uint8_t> input = loadCorpus(corpus, size);
+    std::vector<uint8_t> compressed, decoded;
+    size_t compressedSize = 0, decodedSize = 0;
+    result.inputSize = input.size();
+    result.compressSeconds = timeBest(iterations, [&] { compressedSize = codec.compress(input, compressed); });
+    result.decompressSeconds = timeBest(iterations, [&] {
+        decodedSize = codec.decompress(compressed, compressedSize, decoded, input.size());
+    });
+    if (decodedSize != input.size() || !std::equal(input.begin(), input.end(), decoded.begin()))
+        throw std::runtime_error("round trip mismatch");
+    result.outputSize = compressedSize;
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    result.peakRssKb = usage.ru_maxrss; // kilobytes on Linux
+    result.ok = true;
+    return result;
+}
+
+// Runs one benchmark in a child process and collects its Result over a pipe.
+Result runIsolated(const Codec &codec, const Corpus &corpus, size_t size, int iterations)
+{
+    int fds[2];
+    if (pipe(fds) != 0) throw std::runtime_error("Cannot create pipe.");
+    pid_t pid = fork();
+    if (pid < 0) throw std::runtime_error("Cannot fork benchmark process.");
+    if (pid == 0) {
+        close(fds[0]);
+        Result result;
+        try {
+            result = runOne(codec, corpus, size, iterations);
+        } catch (const std::exception &e) {
+            std::strncpy(result.error, e.what(), sizeof(result.error) - 1);
+        }
+        ssize_t written = write(fds[1], &result, sizeof(result));
+        _exit(written == static_cast<ssize_t>(sizeof(result)) ? 0 : 1);
+    }
+    close(fds[1]);
+    Result result;
+    ssize_t got = read(fds[0], &result, sizeof(result));
+    close(fds[0]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (got != static_cast<ssize_t>(sizeof(result))) {
+        result = Result();
+        std::strncpy(result.error, "benchmark process crashed", sizeof(result.error) - 1);
+    }
+    return result;
+}
+
+double mbPerSecond(uint64_t bytes, double seconds)
+{
+    return seconds > 0 ? bytes / seconds / (1 << 20) : 0;
+}
+
+double compressionRatio(const Result &r)
+{
+    return r.outputSize ? double(r.inputSize) / r.outputSize : 0;
+}
+
+std::string jsonEscape(const std::string &s)
+{
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') out.push_back('\\');
+        if (static_cast<unsigned char>(c) < 0x20) continue;
+        out.push_back(c);
+    }
+    return out;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    size_t size = DEFAULT_CORPUS_SIZE;
+    int iterations = DEFAULT_ITERATIONS;
+    bool json = false;
+    std::string codecFilter;
+    std::vector<Corpus> corpora;
+    bool builtIn = true;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        try {
+            if (arg == "-i") {
+                iterations = std::stoi(i + 1 < argc ? argv[++i] : "");
+                if (iterations < 1) throw std::invalid_argument(arg);
+            } else if (arg == "--size") {
+                size = std::stoul(i + 1 < argc ? argv[++i] : "");
+            } else if (arg == "--codec") {
+                codecFilter = i + 1 < argc ? argv[++i] : "";
+            } else if (arg == "--json") {
+                json = true;
+            } else if (arg == "--files-only") {
+                builtIn = false;
+            } else if (!arg.empty() && arg[0] == '-') {
+                throw std::invalid_argument(arg);
+            } else {
+                corpora.push_back({arg.substr(arg.find_last_of('/') + 1), arg});
+            }
+        } catch (const std::exception &) {
+            std::cerr << "Usage: bench [-i iterations] [--size bytes] [--codec lz4-fast|lz4-high|lz4-large|lz4-dict|lz4-huff|base64|huffman|tans] [--json] [--files-only] [file...]\n";
+            return 1;
+        }
+    }
+    if (builtIn) {
+        std::vector<Corpus> synthetic = {{"text", ""}, {"random", ""}, {"repetitive", ""}, {"dup-random", ""}, {"binary", ""}};
+        corpora.insert(corpora.begin(), synthetic.begin(), synthetic.end());
+    }
+
+    std::vector<Codec> codecs = makeCodecs();
+    if (!codecFilter.empty()) {
+        codecs.erase(std::remove_if(codecs.begin(), codecs.end(), [&](const Codec &c) { return c.name != codecFilter; }),
+                     codecs.end());
+        if (codecs.empty()) {
+            std::cerr << "Unknown codec: " << codecFilter << '\n';
+            return 1;
+        }
+    }
+
+    bool failed = false;
+    bool first = true;
+    if (json) {
+        std::cout << "{\"iterations\": " << iterations << ", \"results\": [";
+    } else {
+        std::cout << std::left << std::setw(10) << "codec" << std::setw(14) << "corpus" << std::right
+                  << std::setw(12) << "size" << std::setw(9) << "ratio" << std::setw(12) << "comp MB/s"
+                  << std::setw(12) << "dec MB/s" << std::setw(12) << "peak RSS KB" << '\n';
+    }
+    for (const Codec &codec : codecs) {
+        for (const Corpus &corpus : corpora) {
+            Result r = runIsolated(codec, corpus, size, iterations);
+            if (!r.ok) {
+                failed = true;
+                std::cerr << codec.name << " on " << corpus.name << " failed: " << r.error << '\n';
+                continue;
+            }
+            if (json) {
+                std::cout << (first ? "" : ",") << "\n  {\"codec\": \"" << codec.name << "\", \"corpus\": \""
+                          << jsonEscape(corpus.name) << "\", \"input_bytes\": " << r.inputSize
+                          << ", \"output_bytes\": " << r.outputSize << ", \"ratio\": " << compressionRatio(r)
+                          << ", \"compress_mbps\": " << mbPerSecond(r.inputSize, r.compressSeconds)
+                          << ", \"decompress_mbps\": " << mbPerSecond(r.inputSize, r.decompressSeconds)
+                          << ", \"peak_rss_kb\": " << r.peakRssKb << "}";
+            } else {
+                std::cout << std::left << std::setw(10) << codec.name << std::setw(14) << corpus.name.substr(0, 13)
+                          << std::right << std::setw(12) << r.inputSize << std::fixed << std::setprecision(3)
+                          << std::setw(9) << compressionRatio(r) << std::setprecision(1) << std::setw(12)
+                          << mbPerSecond(r.inputSize, r.compressSeconds) << std::setw(12)
+                          << mbPerSecond(r.inputSize, r.decompressSeconds) << std::setw(12) << r.peakRssKb << '\n';
+            }
+            first = false;
+        }
+    }
+    if (json) std::cout << "\n]}\n";
+    return failed ? 1 : 0;
+}
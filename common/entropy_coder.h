@@ -0,0 +1,20 @@
+#ifndef ENTROPY_CODER_H
+#define ENTROPY_CODER_H
+#include <cstddef>
+#include <cstdint>
+
+// An order-0 entropy coder over whole in-memory buffers, as plain function
+// pointers so a caller can pick one at runtime (the way base64 picks its
+// kernels). Every coder writes self-describing output: decompressedSize()
+// reads the size back from it. All four throw std::runtime_error on
+// malformed input or a too-small dst; compress() needs dstCapacity >=
+// compressBound(srcSize).
+struct EntropyCoder
+{
+    const char *name;
+    size_t (*compressBound)(size_t srcSize);
+    size_t (*compress)(const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstCapacity);
+    size_t (*decompressedSize)(const uint8_t *src, size_t srcSize);
+    size_t (*decompress)(const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstCapacity);
+};
+#endif
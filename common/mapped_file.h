@@ -0,0 +1,96 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// A file mapped into memory, so codecs can read their input and write their
+// output in place instead of copying through stream buffers.
+class MappedFile
+{
+public:
+    // Maps an existing file read-only.
+    static MappedFile openRead(const std::string &path)
+    {
+        MappedFile file;
+        file.fd = ::open(path.c_str(), O_RDONLY);
+        if(file.fd < 0) throw std::runtime_error("Cannot open file : " + path);
+        struct stat st;
+        if(::fstat(file.fd, &st) != 0) throw std::runtime_error("Cannot read file : " + path);
+        file.map(static_cast<size_t>(st.st_size), PROT_READ, path);
+        return file;
+    }
+
+    // Creates (or truncates) path with the given size and maps it writable.
+    // Call resize() afterwards if fewer bytes end up being used.
+    static MappedFile create(const std::string &path, size_t size)
+    {
+        MappedFile file;
+        file.fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if(file.fd < 0) throw std::runtime_error("Cannot open file: " + path);
+        if(::ftruncate(file.fd, static_cast<off_t>(size)) != 0) throw std::runtime_error("Cannot resize file: " + path);
+        file.map(size, PROT_READ | PROT_WRITE, path);
+        return file;
+    }
+
+    MappedFile(MappedFile &&other) noexcept
+        : fd(other.fd), ptr(other.ptr), len(other.len)
+    {
+        other.fd = -1;
+        other.ptr = nullptr;
+        other.len = 0;
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    MappedFile &operator=(MappedFile &&) = delete;
+
+    ~MappedFile()
+    {
+        unmap();
+        if(fd >= 0) ::close(fd);
+    }
+
+    const uint8_t *data() const { return ptr; }
+    uint8_t *data() { return ptr; }
+    size_t size() const { return len; }
+
+    // Shrinks a file made by create() to its final length.
+    void resize(size_t size)
+    {
+        if(size > len) throw std::runtime_error("MappedFile can only shrink.");
+        unmap();
+        if(::ftruncate(fd, static_cast<off_t>(size)) != 0) throw std::runtime_error("Cannot resize mapped file.");
+        map(size, PROT_READ | PROT_WRITE, "mapped file");
+    }
+
+private:
+    MappedFile() = default;
+
+    void map(size_t size, int prot, const std::string &path)
+    {
+        len = size;
+        if(size == 0) return; // mmap rejects empty mappings
+        void *p = ::mmap(nullptr, size, prot, MAP_SHARED, fd, 0);
+        if(p == MAP_FAILED) throw std::runtime_error("Cannot map file : " + path);
+        ptr = static_cast<uint8_t *>(p);
+        if(prot == PROT_READ) ::madvise(p, size, MADV_SEQUENTIAL);
+    }
+
+    void unmap()
+    {
+        if(ptr) ::munmap(ptr, len);
+        ptr = nullptr;
+        len = 0;
+    }
+
+    int fd = -1;
+    uint8_t *ptr = nullptr;
+    size_t len = 0;
+};
+#endif
@@ -0,0 +1,172 @@
+#ifndef ORDERED_PIPELINE_H
+#define ORDERED_PIPELINE_H
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "thread_pool.h"
+
+// Three-stage chunk pipeline: a reader thread fills input buffers, the pool
+// transforms them concurrently, and the calling thread writes the results in
+// read order. At most queueDepth chunks are in flight; their input and output
+// buffers are recycled, so a run allocates nothing per chunk once the buffers
+// have grown to the chunk size. The first exception from any stage stops the
+// pipeline and is rethrown from run() after in-flight work has drained.
+class OrderedPipeline
+{
+public:
+    // Fills buf (whose capacity is kept between calls) with the next chunk;
+    // leaving it empty ends the input. Chunk sizes are up to the reader.
+    using Reader = std::function<void(std::vector<uint8_t> &buf)>;
+    // Turns one input chunk into one output chunk; runs on the pool.
+    using Transform = std::function<void(const std::vector<uint8_t> &in, std::vector<uint8_t> &out)>;
+    // Consumes output chunks in input order.
+    using Writer = std::function<void(const std::vector<uint8_t> &out)>;
+
+    // queueDepth is the number of chunks in flight; 0 means twice the pool size.
+    OrderedPipeline(ThreadPool &pool, size_t queueDepth = 0)
+        : pool(pool), depth(queueDepth ? queueDepth : 2 * pool.size())
+    {
+    }
+
+    void run(const Reader &read, const Transform &transform, const Writer &write)
+    {
+        // Pool tasks hold their own reference to the shared state, so a task
+        // that is still signalling completion never touches a dead frame.
+        auto state = std::make_shared<State>(depth);
+        State &st = *state;
+
+        std::thread reader([&] {
+            try
+            {
+                while(true)
+                {
+                    size_t s;
+                    {
+                        std::unique_lock<std::mutex> lock(st.mtx);
+                        st.cv.wait(lock, [&] { return st.stopping || !st.idle.empty(); });
+                        if(st.stopping) return;
+                        s = st.idle.front();
+                        st.idle.pop_front();
+                    }
+                    Slot &slot = st.slots[s];
+                    slot.in.clear();
+                    read(slot.in);
+                    {
+                        std::lock_guard<std::mutex> lock(st.mtx);
+                        if(slot.in.empty())
+                        {
+                            st.inputDone = true;
+                            break;
+                        }
+                        slot.done = false;
+                        st.queue.push_back(s);
+                    }
+                    pool.submit([state, s, &transform] {
+                        Slot &slot = state->slots[s];
+                        try
+                        {
+                            transform(slot.in, slot.out);
+                        }
+                        catch(...)
+                        {
+                            slot.error = std::current_exception();
+                        }
+                        std::lock_guard<std::mutex> lock(state->mtx);
+                        slot.done = true;
+                        state->cv.notify_all();
+                    });
+                }
+            }
+            catch(...)
+            {
+                std::lock_guard<std::mutex> lock(st.mtx);
+                if(!st.error) st.error = std::current_exception();
+                st.inputDone = true;
+            }
+            st.cv.notify_all();
+        });
+
+        while(true)
+        {
+            size_t s;
+            {
+                std::unique_lock<std::mutex> lock(st.mtx);
+                st.cv.wait(lock, [&] {
+                    return (!st.queue.empty() && st.slots[st.queue.front()].done) || (st.queue.empty() && st.inputDone);
+                });
+                if(st.queue.empty() || st.error) break;
+                s = st.queue.front();
+            }
+            Slot &slot = st.slots[s];
+            try
+            {
+                if(slot.error) std::rethrow_exception(slot.error);
+                write(slot.out);
+            }
+            catch(...)
+            {
+                std::lock_guard<std::mutex> lock(st.mtx);
+                st.error = std::current_exception();
+                break;
+            }
+            {
+                std::lock_guard<std::mutex> lock(st.mtx);
+                st.queue.pop_front();
+                st.idle.push_back(s);
+            }
+            st.cv.notify_all();
+        }
+
+        // Stop the reader, then wait for queued transforms: they still use
+        // the caller's transform function.
+        {
+            std::lock_guard<std::mutex> lock(st.mtx);
+            st.stopping = true;
+        }
+        st.cv.notify_all();
+        reader.join();
+        std::unique_lock<std::mutex> lock(st.mtx);
+        st.cv.wait(lock, [&] {
+            for(size_t s : st.queue)
+                if(!st.slots[s].done) return false;
+            return true;
+        });
+        if(st.error) std::rethrow_exception(st.error);
+    }
+
+private:
+    struct Slot
+    {
+        std::vector<uint8_t> in;
+        std::vector<uint8_t> out;
+        bool done = false;
+        std::exception_ptr error;
+    };
+
+    struct State
+    {
+        explicit State(size_t depth) : slots(depth)
+        {
+            for(size_t i = 0; i < depth; i++) idle.push_back(i);
+        }
+
+        std::vector<Slot> slots;
+        std::deque<size_t> idle;  // slots free for the reader
+        std::deque<size_t> queue; // slots holding chunks, in read order
+        bool inputDone = false;
+        bool stopping = false;
+        std::exception_ptr error;
+        std::mutex mtx;
+        std::condition_variable cv;
+    };
+
+    ThreadPool &pool;
+    size_t depth;
+};
+#endif
@@ -0,0 +1,167 @@
+#ifndef WORK_STEALING_POOL_H
+#define WORK_STEALING_POOL_H
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "thread_pool.h"
+
+// Worker threads with a task deque each, for fork-join work whose tasks
+// submit more tasks (a directory walk, uneven per-file jobs). A task
+// submitted from a worker goes to the back of that worker's own deque, and a
+// worker runs its newest task first, so related work stays on one thread;
+// an idle worker steals the oldest task of another. Tasks submitted from
+// outside the pool are dealt out round-robin. Unlike ThreadPool there are no
+// futures: wait() joins everything submitted so far, however deeply nested.
+class WorkStealingPool
+{
+public:
+    explicit WorkStealingPool(size_t threads)
+    {
+        if(threads == 0) threads = ThreadPool::defaultThreads();
+        for(size_t i = 0; i < threads; i++) queues.emplace_back(new Queue);
+        for(size_t i = 0; i < threads; i++)
+            workers.emplace_back([this, i] { workerLoop(i); });
+    }
+
+    ~WorkStealingPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        wake.notify_all();
+        for(auto &w : workers) w.join();
+    }
+
+    WorkStealingPool(const WorkStealingPool &) = delete;
+    WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+    // Runs fn on some worker. May be called from inside a task.
+    template <typename F>
+    void submit(F &&fn)
+    {
+        size_t index = currentPool() == this ? currentIndex() : next++ % queues.size();
+        unfinished++;
+        {
+            std::lock_guard<std::mutex> lock(queues[index]->mtx);
+            queues[index]->tasks.emplace_back(std::forward<F>(fn));
+            queued++;
+        }
+        // Passing through mtx means a worker about to sleep either sees the
+        // new count or is already waiting when notified.
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+        }
+        wake.notify_one();
+    }
+
+    // Blocks until every task submitted so far, including the ones those
+    // tasks submitted, has finished; then rethrows the first exception any
+    // of them threw. Must not be called from inside a task.
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        done.wait(lock, [this] { return unfinished == 0; });
+        if(error)
+        {
+            std::exception_ptr e = error;
+            error = nullptr;
+            std::rethrow_exception(e);
+        }
+    }
+
+    size_t size() const { return workers.size(); }
+
+private:
+    struct Queue
+    {
+        std::mutex mtx;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    static const WorkStealingPool *&currentPool()
+    {
+        thread_local const WorkStealingPool *pool = nullptr;
+        return pool;
+    }
+
+    static size_t &currentIndex()
+    {
+        thread_local size_t index = 0;
+        return index;
+    }
+
+    // Own deque from the back, then the others from the front.
+    bool take(size_t self, std::function<void()> &task)
+    {
+        for(size_t k = 0; k < queues.size(); k++)
+        {
+            Queue &q = *queues[(self + k) % queues.size()];
+            std::lock_guard<std::mutex> lock(q.mtx);
+            if(q.tasks.empty()) continue;
+            if(k == 0)
+            {
+                task = std::move(q.tasks.back());
+                q.tasks.pop_back();
+            }
+            else
+            {
+                task = std::move(q.tasks.front());
+                q.tasks.pop_front();
+            }
+            queued--;
+            return true;
+        }
+        return false;
+    }
+
+    void workerLoop(size_t self)
+    {
+        currentPool() = this;
+        currentIndex() = self;
+        while(true)
+        {
+            std::function<void()> task;
+            if(take(self, task))
+            {
+                try
+                {
+                    task();
+                }
+                catch(...)
+                {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    if(!error) error = std::current_exception();
+                }
+                task = nullptr;
+                if(--unfinished == 0)
+                {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    done.notify_all();
+                }
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(mtx);
+            wake.wait(lock, [this] { return stopping || queued > 0; });
+            if(stopping && queued == 0) return;
+        }
+    }
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> next{0};       // round-robin target for outside submits
+    std::atomic<size_t> queued{0};     // tasks waiting in some deque
+    std::atomic<size_t> unfinished{0}; // tasks submitted and not yet finished
+    std::mutex mtx;
+    std::condition_variable wake; // workers: a task was queued, or stopping
+    std::condition_variable done; // wait(): unfinished reached 0
+    std::exception_ptr error;
+    bool stopping = false;
+};
+#endif
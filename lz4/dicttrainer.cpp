@@ -0,0 +1,67 @@
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "lz4dict.h"
+
+// Builds a preset dictionary for `lz4 -D` from a corpus of sample files.
+// Directories are searched recursively; every regular file is one sample.
+
+void addSample(const std::filesystem::path &path, std::vector<std::vector<uint8_t>> &samples)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in) throw std::runtime_error("Cannot open file : " + path.string());
+    samples.emplace_back((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+int main(int argc, char *argv[])
+{
+    size_t maxSize = LZ4Dictionary::DEFAULT_TRAINED_SIZE;
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--maxdict") {
+            try {
+                maxSize = std::stoul(i + 1 < argc ? argv[++i] : "");
+            } catch (const std::exception &) {
+                std::cerr << "Invalid dictionary size\n";
+                return 1;
+            }
+        } else {
+            args.push_back(arg);
+        }
+    }
+    if (args.size() < 2) {
+        std::cerr << "Usage: lz4dict [--maxdict bytes] <output_dictionary> <sample_file|directory>...\n";
+        return 1;
+    }
+
+    try
+    {
+        std::vector<std::vector<uint8_t>> samples;
+        for (size_t i = 1; i < args.size(); ++i) {
+            std::filesystem::path path(args[i]);
+            if (std::filesystem::is_directory(path)) {
+                for (const auto &entry : std::filesystem::recursive_directory_iterator(path))
+                    if (entry.is_regular_file()) addSample(entry.path(), samples);
+            } else {
+                addSample(path, samples);
+            }
+        }
+
+        std::vector<uint8_t> dict = LZ4Dictionary::train(samples, maxSize);
+        std::ofstream out(args[0], std::ios::binary);
+        if (!out || !out.write(reinterpret_cast<const char*>(dict.data()), dict.size()))
+            throw std::runtime_error("Failed to write file: " + args[0]);
+        std::cout << "Trained " << dict.size() << " byte dictionary (id " << LZ4Dictionary(dict).id()
+                  << ") from " << samples.size() << " samples\n";
+    }
+    catch(const std::exception &e)
+    {
+        std::cerr << "Error : " << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
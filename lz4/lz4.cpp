@@ -1,169 +1,692 @@
 #include "lz4.h"
+#include "lz4dict.h"
 #include <vector>
 #include <string>
 #include <cstring>
 #include <iostream>
-void appendLength(std::vector<uint8_t> &out, size_t len)
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <ostream>
+#include <stdexcept>
+#include <climits>
+#include <cmath>
+
+constexpr int HIGH_SEARCH_DEPTH = 64;
+// Incompressibility check: inputs of at least MIN_SAMPLED_INPUT bytes are
+// sampled at up to HISTOGRAM_SAMPLES evenly spaced bytes, and count as
+// incompressible when the order-0 entropy of the sample is at least
+// INCOMPRESSIBLE_BITS per byte. A uniform sample of this size measures
+// about 7.95 bits; text and executables stay well under 7. The histogram
+// cannot see repeats, so such input is still searched at the Fast level,
+// only with the step growing every 1 << INCOMPRESSIBLE_SKIP_LOG misses.
+constexpr size_t MIN_SAMPLED_INPUT = 4096;
+constexpr size_t HISTOGRAM_SAMPLES = 4096;
+constexpr double INCOMPRESSIBLE_BITS = 7.9;
+constexpr int INCOMPRESSIBLE_SKIP_LOG = 4;
+
+static constexpr size_t ceilPow2(size_t n)
+{
+    size_t p = 1;
+    while(p < n) p <<= 1;
+    return p;
+}
+
+// Compile-time parameters of one encoder instance: the hash table has
+// 1 << HashBits entries, sequences are hashed and matched from MinMatch bytes,
+// matches reach back at most Window bytes, and with SkipLog > 0 the Fast
+// level's step grows by one every 1 << SkipLog misses since the last match.
+// Hashing more than 4 bytes loads a whole 8-byte word, so positions within
+// HASH_READ bytes of the end are not searched.
+template <int HashBits, int MinMatch, size_t Window, int SkipLog>
+struct LZ4Params
+{
+    static_assert(HashBits >= 8 && HashBits <= 20, "hash table size out of range");
+    static_assert(MinMatch >= 4 && MinMatch <= 8, "the token format's minimum match is 4");
+    static_assert(Window <= SimpleLZ4::WINDOW_SIZE, "offsets are 16 bits");
+
+    static constexpr int HASH_BITS = HashBits;
+    static constexpr size_t HASH_SIZE = size_t(1) << HashBits;
+    static constexpr size_t MIN_MATCH = MinMatch;
+    static constexpr size_t HASH_READ = MinMatch == 4 ? 4 : 8;
+    static constexpr size_t WINDOW = Window;
+    static constexpr size_t CHAIN_SIZE = ceilPow2(Window + 1); // covers the window
+    static constexpr int SKIP_LOG = SkipLog;
+
+    static inline unsigned int hash(const uint8_t *p)
+    {
+        if constexpr(MinMatch == 4)
+        {
+            uint32_t sequence;
+            std::memcpy(&sequence, p, 4);
+            return (sequence * 2654435761U) >> (32 - HashBits);
+        }
+        else
+        {
+            // The first MinMatch bytes (the low ones, little-endian) go to
+            // the top of the word, so the multiply carries each of them into
+            // the high bits kept.
+            uint64_t sequence;
+            std::memcpy(&sequence, p, 8);
+            return static_cast<unsigned int>(((sequence << (64 - 8 * MinMatch)) * 0x9E3779B97F4A7C15ull) >> (64 - HashBits));
+        }
+    }
+};
+
+using DefaultParams = LZ4Params<16, 4, SimpleLZ4::WINDOW_SIZE, 6>;
+using SmallParams = LZ4Params<12, 4, (1 << 14) - 1, 6>;
+using LargeParams = LZ4Params<17, 5, SimpleLZ4::WINDOW_SIZE, 6>;
+
+// P with the steeper skip used on input that looks incompressible.
+template <class P>
+using SparseParams = LZ4Params<P::HASH_BITS, static_cast<int>(P::MIN_MATCH), P::WINDOW, INCOMPRESSIBLE_SKIP_LOG>;
+
+#if LZ4_STATS
+// The stats of the compress() call running on this thread, or nullptr.
+thread_local LZ4Stats *activeStats = nullptr;
+
+// Attaches stats to this thread for the duration of one compress() call.
+class StatsScope
+{
+public:
+    explicit StatsScope(LZ4Stats *stats) : previous(activeStats) { activeStats = stats; }
+    ~StatsScope() { activeStats = previous; }
+
+private:
+    LZ4Stats *previous;
+};
+
+// Runs statement with s bound to the active stats, if any.
+#define LZ4_COUNT(statement) do { if(activeStats) { LZ4Stats &s = *activeStats; statement; } } while(0)
+
+// Timing without RAII, so the hot functions keep their shape when detached:
+//   uint64_t t = LZ4_CLOCK(); ...; LZ4_ELAPSED(matchFindNanos, t);
+static inline uint64_t statsClock()
+{
+    if(!activeStats) return 0;
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#define LZ4_CLOCK() statsClock()
+#define LZ4_ELAPSED(field, startNanos) LZ4_COUNT(s.field += statsClock() - (startNanos))
+#define LZ4_STATS_SCOPE(stats) StatsScope statsScope(stats)
+#else
+#define LZ4_COUNT(statement) do {} while(0)
+#define LZ4_CLOCK() uint64_t(0)
+#define LZ4_ELAPSED(field, startNanos) ((void)(startNanos))
+#define LZ4_STATS_SCOPE(stats) do {} while(0)
+#endif
+
+int LZ4Stats::bucket(uint64_t value)
+{
+    int b = 0;
+    while(value && b < BUCKETS - 1)
+    {
+        value >>= 1;
+        ++b;
+    }
+    return b;
+}
+
+void LZ4Stats::merge(const LZ4Stats &other)
+{
+    inputBytes += other.inputBytes;
+    outputBytes += other.outputBytes;
+    hashProbes += other.hashProbes;
+    hashCollisions += other.hashCollisions;
+    matchesFound += other.matchesFound;
+    sequences += other.sequences;
+    literalBytes += other.literalBytes;
+    matchBytes += other.matchBytes;
+    matchFindNanos += other.matchFindNanos;
+    encodeNanos += other.encodeNanos;
+    incompressibleBytes += other.incompressibleBytes;
+    for(int b = 0; b < BUCKETS; ++b)
+    {
+        matchLengths[b] += other.matchLengths[b];
+        offsets[b] += other.offsets[b];
+        literalRuns[b] += other.literalRuns[b];
+    }
+}
+
+static void printHistogram(std::ostream &out, const char *name, const uint64_t (&histogram)[LZ4Stats::BUCKETS])
+{
+    out << name << ":\n";
+    for(int b = 0; b < LZ4Stats::BUCKETS; ++b)
+    {
+        if(!histogram[b]) continue;
+        uint64_t low = b ? uint64_t(1) << (b - 1) : 0;
+        uint64_t high = b ? (uint64_t(1) << b) - 1 : 0;
+        std::string range = b == LZ4Stats::BUCKETS - 1 ? ">= " + std::to_string(low)
+                          : low == high ? std::to_string(low)
+                                        : std::to_string(low) + "-" + std::to_string(high);
+        out << "  " << std::left << std::setw(14) << range << std::right << histogram[b] << '\n';
+    }
+}
+
+void LZ4Stats::print(std::ostream &out) const
+{
+    if(!ENABLED)
+    {
+        out << "LZ4 statistics were compiled out (LZ4_STATS=0).\n";
+        return;
+    }
+    out << "input bytes       " << inputBytes << '\n'
+        << "output bytes      " << outputBytes << '\n'
+        << "hash probes       " << hashProbes << '\n'
+        << "hash collisions   " << hashCollisions << '\n'
+        << "matches found     " << matchesFound << '\n'
+        << "sequences         " << sequences << '\n'
+        << "literal bytes     " << literalBytes << '\n'
+        << "match bytes       " << matchBytes << '\n'
+        << "match finding ms  " << matchFindNanos / 1000000 << '\n'
+        << "token encoding ms " << encodeNanos / 1000000 << '\n'
+        << "incompressible    " << incompressibleBytes << '\n';
+    printHistogram(out, "match lengths", matchLengths);
+    printHistogram(out, "offsets", offsets);
+    printHistogram(out, "literal runs", literalRuns);
+}
+
+static inline size_t matchLength(const uint8_t *input, size_t inputSize, size_t candidate, size_t currPos)
+{
+    size_t len = 0;
+    size_t maxLen = inputSize - currPos;
+    while(len < maxLen && input[candidate + len] == input[currPos + len]) ++len;
+    return len;
+}
+
+static inline void appendLength(uint8_t *&op, size_t len)
 {
     while(len >= 255)
     {
-        out.push_back(255);
+        *op++ = 255;
         len -= 255;
     }
-    out.push_back(static_cast<uint8_t>(len));
+    *op++ = static_cast<uint8_t>(len);
 }
 
-void SimpleLZ4::encodeToken(std::vector<uint8_t> &output, int literalLength, int matchLength, int offset, const std::vector<uint8_t> &literals) 
+void SimpleLZ4::encodeToken(uint8_t *&op, uint8_t *oend, const uint8_t *literals, size_t literalLength, size_t matchLength, size_t offset)
 {
+    // Worst case: token, both length extensions, the literals and the offset.
+    uint64_t startNanos = LZ4_CLOCK();
+    size_t needed = 1 + (literalLength / 255 + 1) + literalLength + 2 + (matchLength / 255 + 1);
+    if(needed > static_cast<size_t>(oend - op)) throw std::runtime_error("Output buffer too small during compression.");
+
     // Token : [literal length] (4 bits)  [matchLength - MIN_MATCH_LENGTH] (4 bits)
-    uint8_t lit = std::min(literalLength, 15);
-    uint8_t mat = matchLength >= MIN_MATCH_LENGTH ? std::min(matchLength - MIN_MATCH_LENGTH, 15) : 0;
-    uint8_t token = (lit << 4) | mat;
-    output.push_back(token);
-    if(literalLength >= 15) appendLength(output, literalLength - 15);
-    output.insert(output.end(), literals.begin(), literals.end());
+    LZ4_COUNT(
+        s.sequences++;
+        s.literalBytes += literalLength;
+        s.literalRuns[LZ4Stats::bucket(literalLength)]++;
+        if(matchLength >= MIN_MATCH_LENGTH)
+        {
+            s.matchBytes += matchLength;
+            s.matchLengths[LZ4Stats::bucket(matchLength)]++;
+            s.offsets[LZ4Stats::bucket(offset)]++;
+        });
+    uint8_t lit = static_cast<uint8_t>(std::min<size_t>(literalLength, 15));
+    uint8_t mat = matchLength >= MIN_MATCH_LENGTH ? static_cast<uint8_t>(std::min<size_t>(matchLength - MIN_MATCH_LENGTH, 15)) : 0;
+    *op++ = (lit << 4) | mat;
+    if(literalLength >= 15) appendLength(op, literalLength - 15);
+    if(literalLength) std::memcpy(op, literals, literalLength);
+    op += literalLength;
     if(matchLength >= MIN_MATCH_LENGTH)
     {
-        output.push_back(offset & 0xFF);
-        output.push_back((offset >> 8) & 0xFF); // little-endian
+        *op++ = offset & 0xFF;
+        *op++ = (offset >> 8) & 0xFF; // little-endian
         if(matchLength >= MIN_MATCH_LENGTH + 15)
-            appendLength(output, matchLength - 15 - MIN_MATCH_LENGTH);
+            appendLength(op, matchLength - 15 - MIN_MATCH_LENGTH);
+    }
+    LZ4_ELAPSED(encodeNanos, startNanos);
+}
+
+LZ4Context::LZ4Context()
+    : hashTable(DefaultParams::HASH_SIZE, 0)
+{
+}
+
+uint32_t LZ4Context::begin(size_t inputSize, size_t hashSize, size_t chainSize)
+{
+    if(inputSize > INT_MAX) throw std::runtime_error("Input too large for a single LZ4 block.");
+    // New entries are 0, which is below every base and so reads as empty.
+    if(hashTable.size() < hashSize) hashTable.resize(hashSize, 0);
+    if(chainTable.size() < chainSize) chainTable.resize(chainSize, 0);
+    if(inputSize >= UINT32_MAX - next)
+    {
+        // The base would wrap around, so clear the table and start over.
+        // Chain entries are always written before they are read and can stay.
+        std::fill(hashTable.begin(), hashTable.end(), 0);
+        next = 1;
     }
+    base = next;
+    next = base + static_cast<uint32_t>(inputSize);
+    return base;
 }
 
-bool SimpleLZ4::findLongestMatch(const std::vector<uint8_t> &input, size_t currPos, size_t windowStart, size_t &matchPos, size_t &matchLen)
+// Context for the overloads that take none; one per thread so frame blocks
+// can be compressed concurrently.
+static LZ4Context &threadContext()
 {
-    constexpr int HASH_BITS = 16;
-    constexpr int HASH_SIZE = 1<<16;
-    static std::vector<int> hashTable(HASH_SIZE, -1);
+    thread_local LZ4Context ctx;
+    return ctx;
+}
 
-    if(currPos + MIN_MATCH_LENGTH > input.size()) return false;
-    unsigned int sequence = 0;
-    std::memcpy(&sequence, &input[currPos], MIN_MATCH_LENGTH);
-    unsigned int hash = ((sequence*2654435761U) >> (32 - HASH_BITS)) & (HASH_BITS - 1);
-    int candidate = hashTable[hash];
-    hashTable[hash] = static_cast<int>(currPos);
+template <class P>
+bool SimpleLZ4::findLongestMatch(LZ4Context &ctx, uint32_t base, const uint8_t *input, size_t inputSize, size_t currPos, size_t windowStart,
+                                 const int *dictTable, size_t &matchPos, size_t &matchLen)
+{
+    if(currPos + P::HASH_READ > inputSize) return false;
+    unsigned int hash = P::hash(&input[currPos]);
+    uint32_t entry = ctx.hashTable[hash];
+    ctx.hashTable[hash] = base + static_cast<uint32_t>(currPos);
+    // Entries below base were left by an earlier input.
+    int candidate = entry >= base ? static_cast<int>(entry - base) : -1;
+    // Fall back to the dictionary's pre-built table, whose positions are in
+    // the same coordinates since the dictionary sits right before the input.
+    if(candidate < 0 && dictTable) candidate = dictTable[hash];
     
     matchLen = 0;
     matchPos = 0;
-    if(candidate < 0 || static_cast<size_t>(candidate) <= windowStart || candidate >= static_cast<int>(currPos))
-        return 0;
+    if(candidate < 0 || static_cast<size_t>(candidate) < windowStart || candidate >= static_cast<int>(currPos))
+        return false;
     
-    size_t maxLen = input.size() - currPos;
-    while(matchLen < maxLen && input[candidate + matchLen] == input[currPos + matchLen])
-    {
-        ++matchLen;
-    }
-    if(matchLen >= MIN_MATCH_LENGTH)
+    matchLen = matchLength(input, inputSize, candidate, currPos);
+    LZ4_COUNT(s.hashProbes++);
+    if(matchLen >= P::MIN_MATCH)
     {
+        LZ4_COUNT(s.matchesFound++);
         matchPos = candidate;
         return true;
     }
+    LZ4_COUNT(s.hashCollisions++);
     return false;
 }
 
-std::vector<uint8_t> SimpleLZ4::compress(const std::vector<uint8_t> &input) 
+template <class P>
+void SimpleLZ4::insertChain(LZ4Context &ctx, uint32_t base, const uint8_t *input, size_t inputSize, size_t &nextInsert, size_t target)
+{
+    for(; nextInsert < target && nextInsert + P::HASH_READ <= inputSize; ++nextInsert)
+    {
+        unsigned int hash = P::hash(&input[nextInsert]);
+        ctx.chainTable[nextInsert % P::CHAIN_SIZE] = ctx.hashTable[hash];
+        ctx.hashTable[hash] = base + static_cast<uint32_t>(nextInsert);
+    }
+}
+
+template <class P>
+bool SimpleLZ4::findChainMatch(LZ4Context &ctx, uint32_t base, const uint8_t *input, size_t inputSize, size_t currPos, size_t &nextInsert,
+                               size_t &matchPos, size_t &matchLen)
+{
+    matchLen = 0;
+    matchPos = 0;
+    if(currPos + P::HASH_READ > inputSize) return false;
+    uint64_t startNanos = LZ4_CLOCK();
+
+    // Everything before currPos is searchable; currPos itself goes in afterwards.
+    insertChain<P>(ctx, base, input, inputSize, nextInsert, currPos);
+    size_t windowStart = (currPos > P::WINDOW) ? currPos - P::WINDOW : 0;
+    uint32_t candidate = ctx.hashTable[P::hash(&input[currPos])];
+    // Entries below base (including empty ones) were left by an earlier input.
+    for(int depth = 0; depth < HIGH_SEARCH_DEPTH && candidate >= base; ++depth)
+    {
+        size_t cand = candidate - base;
+        if(cand < windowStart || cand >= currPos) break;
+        LZ4_COUNT(s.hashProbes++);
+        // Cheap reject: a longer match must also agree at the byte past the current best.
+        if(matchLen == 0 || input[cand + matchLen] == input[currPos + matchLen])
+        {
+            size_t len = matchLength(input, inputSize, cand, currPos);
+            if(len > matchLen)
+            {
+                matchLen = len;
+                matchPos = cand;
+                if(currPos + len == inputSize) break;
+            }
+            else if(len < P::MIN_MATCH)
+            {
+                LZ4_COUNT(s.hashCollisions++);
+            }
+        }
+        uint32_t next = ctx.chainTable[cand % P::CHAIN_SIZE];
+        if(next >= candidate) break; // slot was reused by a newer position
+        candidate = next;
+    }
+    insertChain<P>(ctx, base, input, inputSize, nextInsert, currPos + 1);
+    LZ4_ELAPSED(matchFindNanos, startNanos);
+    if(matchLen < P::MIN_MATCH) return false;
+    LZ4_COUNT(s.matchesFound++);
+    return true;
+}
+
+std::vector<uint8_t> SimpleLZ4::compress(const std::vector<uint8_t> &input)
+{
+    return compress(input, 0);
+}
+
+std::vector<uint8_t> SimpleLZ4::compress(const std::vector<uint8_t> &input, size_t start)
+{
+    if(start > input.size()) throw std::runtime_error("Compression start past end of input.");
+    std::vector<uint8_t> output(compressBound(input.size() - start));
+    size_t written = compress(input.data() + start, input.size() - start, output.data(), output.size(), start);
+    output.resize(written);
+    return output;
+}
+
+size_t SimpleLZ4::compress(const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstCapacity, size_t prefixLen)
+{
+    return compress(threadContext(), src, srcSize, dst, dstCapacity, prefixLen);
+}
+
+size_t SimpleLZ4::compress(const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstCapacity, const LZ4Dictionary &dict)
+{
+    return compress(threadContext(), src, srcSize, dst, dstCapacity, dict);
+}
+
+size_t SimpleLZ4::compress(LZ4Context &ctx, const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstCapacity, size_t prefixLen)
+{
+    // Positions are counted from the start of the history so that
+    // matches into the prefix are ordinary backward references.
+    const uint8_t *input = src - prefixLen;
+    size_t inputSize = prefixLen + srcSize;
+    uint8_t *op = dst;
+    LZ4_STATS_SCOPE(stats);
+    compressInput(ctx, input, inputSize, prefixLen, nullptr, op, dst + dstCapacity);
+    LZ4_COUNT(s.inputBytes += srcSize; s.outputBytes += op - dst);
+    return static_cast<size_t>(op - dst);
+}
+
+size_t SimpleLZ4::compress(LZ4Context &ctx, const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstCapacity, const LZ4Dictionary &dict)
+{
+    // Matches are found over [dictionary | input] laid out contiguously.
+    std::vector<uint8_t> &scratch = ctx.scratch;
+    scratch.assign(dict.data(), dict.data() + dict.size());
+    scratch.insert(scratch.end(), src, src + srcSize);
+    uint8_t *op = dst;
+    LZ4_STATS_SCOPE(stats);
+    // The dictionary's pre-built table only matches the Default profile's
+    // hash; other profiles prime their table from the dictionary instead.
+    const int *dictTable = profile == Profile::Default ? dict.hashTable().data() : nullptr;
+    compressInput(ctx, scratch.data(), scratch.size(), dict.size(), dictTable, op, dst + dstCapacity);
+    LZ4_COUNT(s.inputBytes += srcSize; s.outputBytes += op - dst);
+    return static_cast<size_t>(op - dst);
+}
+
+bool SimpleLZ4::looksIncompressible(const uint8_t *src, size_t srcSize)
+{
+    if(srcSize < MIN_SAMPLED_INPUT) return false;
+    uint32_t counts[256] = {};
+    size_t step = std::max<size_t>(1, srcSize / HISTOGRAM_SAMPLES);
+    size_t samples = 0;
+    for(size_t i = 0; i < srcSize && samples < HISTOGRAM_SAMPLES; i += step, ++samples) counts[src[i]]++;
+    double bits = 0;
+    for(uint32_t c : counts)
+        if(c) bits -= c * std::log2(static_cast<double>(c) / samples);
+    return bits >= INCOMPRESSIBLE_BITS * samples;
+}
+
+void SimpleLZ4::compressInput(LZ4Context &ctx, const uint8_t *input, size_t inputSize, size_t start, const int *dictTable, uint8_t *&op, uint8_t *oend) const
+{
+    // Only a hint: High always searches fully, and Fast still finds the
+    // repeats of a duplicated random or compressed file.
+    bool sparse = level == Level::Fast && looksIncompressible(input + start, inputSize - start);
+    if(sparse) LZ4_COUNT(s.incompressibleBytes += inputSize - start);
+    switch(profile)
+    {
+    case Profile::Small:
+        if(level == Level::High) compressHigh<SmallParams>(ctx, input, inputSize, start, op, oend);
+        else if(sparse) compressFast<SparseParams<SmallParams>>(ctx, input, inputSize, start, dictTable, op, oend);
+        else compressFast<SmallParams>(ctx, input, inputSize, start, dictTable, op, oend);
+        break;
+    case Profile::Large:
+        if(level == Level::High) compressHigh<LargeParams>(ctx, input, inputSize, start, op, oend);
+        else if(sparse) compressFast<SparseParams<LargeParams>>(ctx, input, inputSize, start, dictTable, op, oend);
+        else compressFast<LargeParams>(ctx, input, inputSize, start, dictTable, op, oend);
+        break;
+    default:
+        if(level == Level::High) compressHigh<DefaultParams>(ctx, input, inputSize, start, op, oend);
+        else if(sparse) compressFast<SparseParams<DefaultParams>>(ctx, input, inputSize, start, dictTable, op, oend);
+        else compressFast<DefaultParams>(ctx, input, inputSize, start, dictTable, op, oend);
+        break;
+    }
+}
+
+std::vector<int> SimpleLZ4::buildHashTable(const uint8_t *data, size_t size)
+{
+    std::vector<int> table(DefaultParams::HASH_SIZE, -1);
+    for(size_t p = 0; p + DefaultParams::HASH_READ <= size; ++p)
+        table[DefaultParams::hash(&data[p])] = static_cast<int>(p);
+    return table;
+}
+
+template <class P>
+void SimpleLZ4::compressHigh(LZ4Context &ctx, const uint8_t *input, size_t inputSize, size_t start, uint8_t *&op, uint8_t *oend)
+{
+    uint32_t base = ctx.begin(inputSize, P::HASH_SIZE, P::CHAIN_SIZE);
+
+    size_t pos = start;
+    size_t anchor = start; // first byte not yet emitted
+    size_t nextInsert = (start > P::WINDOW) ? start - P::WINDOW : 0;
+    insertChain<P>(ctx, base, input, inputSize, nextInsert, start); // prime with the history prefix
+    while(pos < inputSize)
+    {
+        size_t matchPos = 0, matchLen = 0;
+        if(!findChainMatch<P>(ctx, base, input, inputSize, pos, nextInsert, matchPos, matchLen))
+        {
+            ++pos;
+            continue;
+        }
+
+        // Lazy evaluation: if the match starting one byte later is longer,
+        // leave this byte as a literal and take that match instead.
+        size_t nextPos = 0, nextLen = 0;
+        while(findChainMatch<P>(ctx, base, input, inputSize, pos + 1, nextInsert, nextPos, nextLen) && nextLen > matchLen)
+        {
+            ++pos;
+            matchPos = nextPos;
+            matchLen = nextLen;
+        }
+
+        encodeToken(op, oend, input + anchor, pos - anchor, matchLen, pos - matchPos);
+        pos += matchLen;
+        anchor = pos;
+    }
+    if(anchor < inputSize)
+        encodeToken(op, oend, input + anchor, inputSize - anchor, 0, 0);
+}
+
+template <class P>
+void SimpleLZ4::compressFast(LZ4Context &ctx, const uint8_t *input, size_t inputSize, size_t start, const int *dictTable, uint8_t *&op, uint8_t *oend)
 {
-    constexpr size_t WINDOW_SIZE = 65535; // 64 KB
-    std::vector<uint8_t> output;
-    std::vector<uint8_t> literals;
+    uint32_t base = ctx.begin(inputSize, P::HASH_SIZE, 0);
+    if(!dictTable)
+    {
+        for(size_t p = (start > P::WINDOW) ? start - P::WINDOW : 0; p < start && p + P::HASH_READ <= inputSize; ++p)
+            ctx.hashTable[P::hash(&input[p])] = base + static_cast<uint32_t>(p); // prime with the history prefix
+    }
 
-    size_t pos = 0;
-    size_t inputSize = input.size();
+    size_t pos = start;
+    size_t anchor = start; // first byte not yet emitted
+    size_t misses = 0;     // positions searched since the last match
     while(pos < inputSize)
     {
         size_t matchPos = 0, matchLen = 0;
-        size_t windowStart = (pos > WINDOW_SIZE) ? pos - WINDOW_SIZE : 0;
+        size_t windowStart = (pos > P::WINDOW) ? pos - P::WINDOW : 0;
 
-        bool found = (pos + MIN_MATCH_LENGTH <= inputSize) && findLongestMatch(input, pos, windowStart, matchPos, matchLen);
+        uint64_t startNanos = LZ4_CLOCK();
+        bool found = findLongestMatch<P>(ctx, base, input, inputSize, pos, windowStart, dictTable, matchPos, matchLen);
+        LZ4_ELAPSED(matchFindNanos, startNanos);
         if(found)
         {
-            int offset = static_cast<int> (pos - matchPos);
-            encodeToken(output, literals.size(), matchLen, offset, literals);
-            literals.clear();
+            encodeToken(op, oend, input + anchor, pos - anchor, matchLen, pos - matchPos);
             pos += matchLen;
+            anchor = pos;
+            misses = 0;
+        }
+        else if(P::SKIP_LOG)
+        {
+            pos += 1 + (misses++ >> P::SKIP_LOG);
         }
         else
         {
-            literals.push_back(input[pos]);
             ++pos;
-            if(literals.size() == 65535)
-            {
-                encodeToken(output, literals.size(), 0, 0, literals);
-                literals.clear();
-            }
         }
-    } 
-    if(!literals.empty())
-        encodeToken(output, literals.size(), 0, 0, literals);
-    return output;
+    }
+    if(anchor < inputSize)
+        encodeToken(op, oend, input + anchor, inputSize - anchor, 0, 0);
 }
 
-size_t SimpleLZ4::decodeLength(const std::vector<uint8_t>& input, size_t& pos) {
+static size_t readLength(const uint8_t *&ip, const uint8_t *iend)
+{
     size_t len = 0;
-    while (pos < input.size() && input[pos] == 255) {
-        len += 255;
-        ++pos;
-    }
-    if (pos < input.size()) {
-        len += input[pos];
-        ++pos;
-    }
+    uint8_t s;
+    do {
+        if (ip >= iend) throw std::runtime_error("Unexpected end of input when reading length.");
+        s = *ip++;
+        len += s;
+    } while (s == 255);
     return len;
 }
 
+// Copies in 16-byte steps and may write up to 15 bytes past dstEnd;
+// callers guarantee that slack on both buffers.
+static inline void wildCopy16(uint8_t *dst, const uint8_t *src, uint8_t *dstEnd)
+{
+    do {
+        std::memcpy(dst, src, 16);
+        dst += 16;
+        src += 16;
+    } while (dst < dstEnd);
+}
 
-std::vector<uint8_t> SimpleLZ4::decompress(const std::vector<uint8_t>& compressed) {
-    std::vector<uint8_t> output;
-    size_t pos = 0;
-
-    while (pos < compressed.size()) {
-        // Read token byte
-        uint8_t token = compressed[pos++];
-        size_t literalLength = token >> 4;
-        size_t matchLength = (token & 0x0F) + MIN_MATCH_LENGTH;
-
-        // Decode literal length extension if applicable
-        if (literalLength == 15) {
-            literalLength += decodeLength(compressed, pos);
-        }
+static inline void wildCopy8(uint8_t *dst, const uint8_t *src, uint8_t *dstEnd)
+{
+    do {
+        std::memcpy(dst, src, 8);
+        dst += 8;
+        src += 8;
+    } while (dst < dstEnd);
+}
 
-        // Bounds check for literal section
-        if (pos + literalLength > compressed.size()) {
-            throw std::runtime_error("Literal length out of bounds during decompression.");
-        }
+// Slack required past the end of a copy before the unchecked wild paths are used.
+constexpr size_t WILD_MARGIN = 32;
+
+size_t SimpleLZ4::decompressBlock(const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstCapacity, size_t prefixLen,
+                                  const uint8_t *extDict, size_t extDictSize)
+{
+    if(extDictSize) return decompressSequences<true>(src, srcSize, dst, dstCapacity, prefixLen, extDict, extDictSize);
+    return decompressSequences<false>(src, srcSize, dst, dstCapacity, prefixLen, nullptr, 0);
+}
 
-        // Copy literals verbatim
-        output.insert(output.end(), compressed.begin() + pos, compressed.begin() + pos + literalLength);
-        pos += literalLength;
+template <bool ExtDict>
+size_t SimpleLZ4::decompressSequences(const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstCapacity, size_t prefixLen,
+                                      const uint8_t *extDict, size_t extDictSize)
+{
+    const uint8_t *ip = src;
+    const uint8_t *const iend = src + srcSize;
+    uint8_t *op = dst;
+    uint8_t *const oend = dst + dstCapacity;
+    const uint8_t *const lowLimit = dst - prefixLen;
 
-        // If at end of input after literals, decompression finished
-        if (pos >= compressed.size()) break;
+    // Spread a short-offset pattern so the remaining copy can move 8 bytes at a time.
+    static const unsigned inc32table[8] = {0, 1, 2, 1, 0, 4, 4, 4};
+    static const int dec64table[8] = {0, 0, 0, -1, -4, 1, 2, 3};
 
-        // Check for sufficient bytes for offset
-        if (pos + 2 > compressed.size()) {
-            throw std::runtime_error("Unexpected end of input when reading offset.");
-        }
+    while (ip < iend) {
+        unsigned token = *ip++;
+
+        // Literals
+        size_t length = token >> 4;
+        if (length == 15) length += readLength(ip, iend);
+        size_t inLeft = static_cast<size_t>(iend - ip);
+        size_t outLeft = static_cast<size_t>(oend - op);
+        if (length > inLeft) throw std::runtime_error("Literal length out of bounds during decompression.");
+        if (length > outLeft) throw std::runtime_error("Output buffer too small during decompression.");
+        if (length + WILD_MARGIN <= inLeft && length + WILD_MARGIN <= outLeft)
+            wildCopy16(op, ip, op + length);
+        else if (length)
+            std::memcpy(op, ip, length);
+        op += length;
+        ip += length;
 
-        // Read offset (little-endian)
-        uint16_t offset = compressed[pos] | (compressed[pos + 1] << 8);
-        pos += 2;
+        // The last sequence has no match part.
+        if (ip == iend) break;
 
-        // Validate offset
-        if (offset == 0 || offset > output.size()) {
+        if (iend - ip < 2) throw std::runtime_error("Unexpected end of input when reading offset.");
+        size_t offset = ip[0] | (ip[1] << 8); // little-endian
+        ip += 2;
+        size_t history = static_cast<size_t>(op - lowLimit);
+        if (offset == 0 || offset > history + (ExtDict ? extDictSize : 0))
             throw std::runtime_error("Invalid offset in decompression.");
-        }
 
-        // Decode match length extension if applicable
-        if ((token & 0x0F) == 15) {
-            matchLength += decodeLength(compressed, pos);
+        // Match
+        length = (token & 0x0F) + MIN_MATCH_LENGTH;
+        if ((token & 0x0F) == 15) length += readLength(ip, iend);
+        outLeft = static_cast<size_t>(oend - op);
+        if (length > outLeft) throw std::runtime_error("Match length out of bounds during decompression.");
+
+        if (ExtDict && offset > history) {
+            // The match starts in the external dictionary, which logically
+            // precedes the history, and may run on into the history itself.
+            size_t back = offset - history;
+            size_t fromDict = std::min(length, back);
+            std::memcpy(op, extDict + extDictSize - back, fromDict);
+            op += fromDict;
+            for (size_t i = 0; i < length - fromDict; ++i) op[i] = lowLimit[i];
+            op += length - fromDict;
+            continue;
         }
 
-        // Copy match bytes (handle overlapping matches)
-        size_t matchPos = output.size() - offset;
-        for (size_t i = 0; i < matchLength; ++i) {
-            output.push_back(output[matchPos + i]);
+        const uint8_t *match = op - offset;
+        uint8_t *const cpy = op + length;
+        if (length + WILD_MARGIN <= outLeft) {
+            if (offset >= 16) {
+                wildCopy16(op, match, cpy);
+            } else if (offset >= 8) {
+                wildCopy8(op, match, cpy);
+            } else {
+                op[0] = match[0];
+                op[1] = match[1];
+                op[2] = match[2];
+                op[3] = match[3];
+                match += inc32table[offset];
+                std::memcpy(op + 4, match, 4);
+                match -= dec64table[offset];
+                op += 8;
+                if (op < cpy) wildCopy8(op, match, cpy);
+            }
+        } else {
+            // Near the end of the buffer: exact, overlap-safe copy.
+            for (size_t i = 0; i < length; ++i) op[i] = match[i];
         }
+        op = cpy;
+    }
+    return static_cast<size_t>(op - dst);
+}
+
+size_t SimpleLZ4::decodedSize(const uint8_t *src, size_t srcSize)
+{
+    const uint8_t *ip = src;
+    const uint8_t *const iend = src + srcSize;
+    size_t total = 0;
+    while (ip < iend) {
+        unsigned token = *ip++;
+        size_t length = token >> 4;
+        if (length == 15) length += readLength(ip, iend);
+        if (length > static_cast<size_t>(iend - ip)) throw std::runtime_error("Literal length out of bounds during decompression.");
+        ip += length;
+        total += length;
+        if (ip == iend) break;
+        if (iend - ip < 2) throw std::runtime_error("Unexpected end of input when reading offset.");
+        ip += 2;
+        length = (token & 0x0F) + MIN_MATCH_LENGTH;
+        if ((token & 0x0F) == 15) length += readLength(ip, iend);
+        total += length;
     }
+    return total;
+}
+
+std::vector<uint8_t> SimpleLZ4::decompress(const std::vector<uint8_t>& compressed) {
+    // Unframed data carries no size, so a cheap token scan sizes the output first.
+    std::vector<uint8_t> output(decodedSize(compressed.data(), compressed.size()));
+    size_t written = decompressBlock(compressed.data(), compressed.size(), output.data(), output.size());
+    if (written != output.size()) throw std::runtime_error("Block size mismatch during decompression.");
     return output;
 }
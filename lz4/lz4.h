@@ -2,17 +2,167 @@
 #define LZ4_H
 #include <vector>
 #include <cstdint>
+#include <cstddef>
+#include <iosfwd>
+
+// Build with -DLZ4_STATS=0 to compile the encoder's counters out entirely.
+#ifndef LZ4_STATS
+#define LZ4_STATS 1
+#endif
+
+class LZ4Dictionary;
+class SimpleLZ4;
+
+// Match-finder state for one compressing thread: the hash and chain tables and
+// the scratch buffer used for dictionary compression. The tables grow to the
+// largest profile used with the context and are then reused, so compressing
+// with a context makes no heap allocations after the first call (dictionary
+// compression may grow the scratch buffer the first few times).
+// Switching to a new input costs O(1): table entries are stored relative to a
+// base that moves past every position of the previous input, so stale entries
+// simply compare as out of the window. A context is not thread-safe; keep one
+// per thread.
+class LZ4Context
+{
+public:
+    LZ4Context();
+
+private:
+    friend class SimpleLZ4;
+
+    // Starts a new input of inputSize bytes, growing the tables to at least
+    // hashSize and chainSize entries, and returns the base its positions are
+    // stored at.
+    uint32_t begin(size_t inputSize, size_t hashSize, size_t chainSize);
+
+    std::vector<uint32_t> hashTable;  // base + position of the last sequence with that hash, 0 = empty
+    std::vector<uint32_t> chainTable; // High level: [pos % CHAIN_SIZE] = previous entry with the same hash
+    std::vector<uint8_t> scratch;     // [dictionary | input] for dictionary compression
+    uint32_t base = 1;
+    uint32_t next = 1; // first value no entry has used yet
+};
+
+// Encoder counters, filled only while attached with SimpleLZ4::setStats().
+// Histograms are bucketed by bit width: bucket 0 holds 0, bucket b holds
+// values in [2^(b-1), 2^b), and the last bucket also takes everything larger.
+struct LZ4Stats
+{
+    static constexpr bool ENABLED = LZ4_STATS != 0;
+    static constexpr int BUCKETS = 24;
+
+    uint64_t inputBytes = 0;
+    uint64_t outputBytes = 0;
+    uint64_t hashProbes = 0;      // candidate positions examined
+    uint64_t hashCollisions = 0;  // candidates in the window sharing fewer than 4 bytes
+    uint64_t matchesFound = 0;    // searches that returned a usable match
+    uint64_t sequences = 0;       // tokens emitted (including the final literal run)
+    uint64_t literalBytes = 0;
+    uint64_t matchBytes = 0;
+    uint64_t matchFindNanos = 0;
+    uint64_t encodeNanos = 0;
+    uint64_t incompressibleBytes = 0; // input searched with the steeper skip
+    uint64_t matchLengths[BUCKETS] = {};
+    uint64_t offsets[BUCKETS] = {};
+    uint64_t literalRuns[BUCKETS] = {};
+
+    static int bucket(uint64_t value);
+    void merge(const LZ4Stats &other);
+    void print(std::ostream &out) const;
+};
 
 class SimpleLZ4
 {
 public:
+    // Fast: one hash probe per position. High: bounded hash-chain search with
+    // lazy matching; slower, better ratio. Both emit the same token format.
+    enum class Level { Fast, High };
+    // Match-finder tuning. Each profile is a separately compiled encoder with
+    // its table size, minimum match, window and skip step as constants; all
+    // of them emit the same token format, and at the Fast level all of them
+    // step further ahead the longer they go without a match.
+    //   Default  64K-entry hash table (256KB, L2-sized), 4-byte matches, 64KB window
+    //   Small    4K-entry hash table (16KB, stays in L1), 16KB window; for
+    //            messages of a few KB, where a big table is mostly cache misses
+    //   Large    128K-entry hash table, 5-byte matches; for throughput on big files
+    enum class Profile { Default, Small, Large };
+
+    explicit SimpleLZ4(Level level = Level::Fast, Profile profile = Profile::Default) : level(level), profile(profile) {}
+
+    // Accumulates counters for every later compress() call into stats (which
+    // must outlive them); nullptr detaches. A no-op when built with LZ4_STATS=0.
+    void setStats(LZ4Stats *s) { stats = s; }
+
+    static constexpr size_t WINDOW_SIZE = 65535; // 64 KB, largest offset a token can hold
+
+    // Largest compressed size of an n-byte block (one literal run).
+    static constexpr size_t compressBound(size_t n) { return n + n / 255 + 16; }
+
+    // Compresses src into dst and returns the compressed size. The prefixLen
+    // bytes before src are history that matches may reference (the last 64KB
+    // of it). Throws if dst is too small; compressBound(srcSize) always fits.
+    size_t compress(LZ4Context &ctx, const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstCapacity, size_t prefixLen = 0);
+    // Compresses src with a preset dictionary as its history.
+    size_t compress(LZ4Context &ctx, const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstCapacity, const LZ4Dictionary &dict);
+    // Same as above with a context owned by the calling thread.
+    size_t compress(const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstCapacity, size_t prefixLen = 0);
+    size_t compress(const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstCapacity, const LZ4Dictionary &dict);
+    // True if a sampled byte histogram of src is close to uniform, as with
+    // compressed media or encrypted data. The Fast level then searches src
+    // with a steeper skip, which still finds whole repeats such as a
+    // duplicated file; LZ4Frame stores blocks that do not shrink raw. Inputs
+    // too short to sample are never judged incompressible.
+    static bool looksIncompressible(const uint8_t *src, size_t srcSize);
+    // Decodes one block into dst, which must hold the exact decoded size.
+    // The prefixLen bytes before dst are history that matches may reference;
+    // extDict, if given, is older history (a dictionary) that precedes them.
+    // Throws on malformed input; never reads or writes outside the buffers.
+    // Returns the number of bytes written.
+    static size_t decompressBlock(const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstCapacity, size_t prefixLen = 0,
+                                  const uint8_t *extDict = nullptr, size_t extDictSize = 0);
+    // Decoded size of a block, found by walking its tokens without copying.
+    static size_t decodedSize(const uint8_t *src, size_t srcSize);
+
+    // Owning-container convenience wrappers around the calls above.
     std::vector<uint8_t> compress(const std::vector<uint8_t> &input);
+    // Compresses input[start..] only, with input[0..start) as history.
+    std::vector<uint8_t> compress(const std::vector<uint8_t> &input, size_t start);
     std::vector<uint8_t> decompress(const std::vector<uint8_t> &compressed);
 
 private:
-    static constexpr int MIN_MATCH_LENGTH = 4;
-    static void encodeToken(std::vector<uint8_t> &output, int literalLength, int matchLength, int offSet, const std::vector<uint8_t> &literals);
-    static size_t decodeLength(const std::vector<uint8_t> &input, size_t &pos);
-    static bool findLongestMatch(const std::vector<uint8_t> &input, size_t currPos, size_t windowStart, size_t &matchPos, size_t &matchLen);
+    friend class LZ4Dictionary;
+
+    static constexpr int MIN_MATCH_LENGTH = 4; // of the token format; a profile may require longer matches
+    Level level;
+    Profile profile;
+    LZ4Stats *stats = nullptr;
+
+    // Fast-level hash table of the Default profile pre-filled with every
+    // position of data.
+    static std::vector<int> buildHashTable(const uint8_t *data, size_t size);
+    // Runs the encoder instance for this codec's level and profile over
+    // input[start..]. dictTable is a buildHashTable() result or nullptr.
+    void compressInput(LZ4Context &ctx, const uint8_t *input, size_t inputSize, size_t start, const int *dictTable, uint8_t *&op, uint8_t *oend) const;
+    static void encodeToken(uint8_t *&op, uint8_t *oend, const uint8_t *literals, size_t literalLength, size_t matchLength, size_t offset);
+
+    // The match finder, instantiated once per profile; P supplies the
+    // hash function and the constants (see LZ4Params in lz4.cpp).
+    template <class P>
+    static void compressFast(LZ4Context &ctx, const uint8_t *input, size_t inputSize, size_t start, const int *dictTable, uint8_t *&op, uint8_t *oend);
+    template <class P>
+    static void compressHigh(LZ4Context &ctx, const uint8_t *input, size_t inputSize, size_t start, uint8_t *&op, uint8_t *oend);
+    template <class P>
+    static bool findLongestMatch(LZ4Context &ctx, uint32_t base, const uint8_t *input, size_t inputSize, size_t currPos, size_t windowStart,
+                                 const int *dictTable, size_t &matchPos, size_t &matchLen);
+    template <class P>
+    static bool findChainMatch(LZ4Context &ctx, uint32_t base, const uint8_t *input, size_t inputSize, size_t currPos, size_t &nextInsert,
+                               size_t &matchPos, size_t &matchLen);
+    template <class P>
+    static void insertChain(LZ4Context &ctx, uint32_t base, const uint8_t *input, size_t inputSize, size_t &nextInsert, size_t target);
+
+    // The decoder, instantiated with and without an external dictionary so
+    // the common case carries no dictionary checks in its loop.
+    template <bool ExtDict>
+    static size_t decompressSequences(const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstCapacity, size_t prefixLen,
+                                      const uint8_t *extDict, size_t extDictSize);
 };
 #endif
\ No newline at end of file
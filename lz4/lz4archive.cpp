@@ -0,0 +1,462 @@
+#include "lz4archive.h"
+#include "../common/mapped_file.h"
+#include "../common/work_stealing_pool.h"
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+struct FileInfo { std::string name, path; uint64_t size; };
+// The part of one file that lies in one block.
+struct Segment { size_t file; uint64_t fileOffset; size_t length; };
+// The part of one extracted file that lies in one block.
+struct Piece { size_t entry; size_t blockOffset; uint64_t fileOffset; size_t length; };
+}
+
+static constexpr uint8_t ARCHIVE_FLAGS = LZ4Frame::FLAG_ENTROPY | LZ4Frame::FLAG_DICT_ID;
+
+// Lists one directory: files are collected, subdirectories become new tasks.
+// Directory symlinks are not followed, so the walk cannot loop.
+static void walkDirectory(WorkStealingPool &pool, const fs::path &root, const fs::path &dir, std::mutex &mtx, std::vector<FileInfo> &files)
+{
+    std::vector<FileInfo> found;
+    for(const fs::directory_entry &entry : fs::directory_iterator(dir))
+    {
+        if(fs::is_directory(entry.symlink_status()))
+        {
+            fs::path sub = entry.path();
+            pool.submit([&pool, &root, sub, &mtx, &files] { walkDirectory(pool, root, sub, mtx, files); });
+        }
+        else if(entry.is_regular_file())
+        {
+            std::string name = entry.path().lexically_relative(root).generic_string();
+            if(name.size() > LZ4Archive::MAX_NAME_LENGTH) throw std::runtime_error("File name too long: " + name);
+            found.push_back({name, entry.path().string(), entry.file_size()});
+        }
+    }
+    std::lock_guard<std::mutex> lock(mtx);
+    files.insert(files.end(), found.begin(), found.end());
+}
+
+static void readAt(const std::string &path, uint64_t offset, uint8_t *dst, size_t len)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0) throw std::runtime_error("Cannot open file : " + path);
+    while(len > 0)
+    {
+        ssize_t n = ::pread(fd, dst, len, static_cast<off_t>(offset));
+        if(n <= 0)
+        {
+            ::close(fd);
+            throw std::runtime_error("File changed while archiving: " + path);
+        }
+        dst += n;
+        offset += static_cast<uint64_t>(n);
+        len -= static_cast<size_t>(n);
+    }
+    ::close(fd);
+}
+
+// Writes len bytes at offset into a file of the given size. Pieces of one
+// file may arrive in any order from any thread: every writer sets the same
+// size before writing, so none of them can cut off another's bytes.
+static void writeAt(const std::string &path, uint64_t size, uint64_t offset, const uint8_t *src, size_t len)
+{
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+    if(fd < 0) throw std::runtime_error("Cannot open file: " + path);
+    bool ok = ::ftruncate(fd, static_cast<off_t>(size)) == 0;
+    while(ok && len > 0)
+    {
+        ssize_t n = ::pwrite(fd, src, len, static_cast<off_t>(offset));
+        ok = n > 0;
+        if(!ok) break;
+        src += n;
+        offset += static_cast<uint64_t>(n);
+        len -= static_cast<size_t>(n);
+    }
+    if(::close(fd) != 0) ok = false;
+    if(!ok) throw std::runtime_error("Failed to write file: " + path);
+}
+
+// Writes all of src to fd at its current position; false on any error.
+static bool writeAll(int fd, const uint8_t *src, size_t len)
+{
+    while(len > 0)
+    {
+        ssize_t n = ::write(fd, src, len);
+        if(n <= 0) return false;
+        src += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Compresses the blocks of plan on the pool and writes them to fd in index
+// order, starting at writePos, so the archive bytes are the same for any
+// thread count. Up to twice the pool size of blocks are compressed ahead of
+// the writer, each into its own slot. Fills index.blocks and returns the
+// position after the last block.
+static uint64_t writeBlocks(WorkStealingPool &pool, int fd, uint64_t writePos, const std::vector<FileInfo> &files,
+                            const std::vector<std::vector<Segment>> &plan, const LZ4Frame::Options &options, LZ4Archive::Index &index)
+{
+    struct Slot
+    {
+        std::vector<uint8_t> packed;
+        uint32_t compressedSize = 0; // with LZ4Frame::BLOCK_STORED
+        uint32_t rawSize = 0;
+        LZ4Stats stats;
+        bool ready = false;
+    };
+    std::vector<Slot> slots(std::min(2 * pool.size(), std::max<size_t>(plan.size(), 1)));
+    std::mutex mtx;
+    std::condition_variable readyCv;
+    bool failed = false;
+
+    auto submit = [&](size_t b) {
+        pool.submit([&, b] {
+            Slot &slot = slots[b % slots.size()];
+            try
+            {
+                thread_local std::vector<uint8_t> raw;
+                thread_local LZ4Context context;
+                size_t rawSize = 0;
+                for(const Segment &s : plan[b]) rawSize += s.length;
+                raw.resize(rawSize);
+                size_t pos = 0;
+                for(const Segment &s : plan[b])
+                {
+                    readAt(files[s.file].path, s.fileOffset, raw.data() + pos, s.length);
+                    pos += s.length;
+                }
+
+                SimpleLZ4 codec(options.level, options.profile);
+                slot.stats = LZ4Stats();
+                if(options.stats) codec.setStats(&slot.stats);
+                slot.packed.resize(LZ4Frame::blockBound(rawSize, index.flags));
+                slot.compressedSize = LZ4Frame::compressBlock(codec, context, index.flags, raw.data(), rawSize, slot.packed.data(), 0,
+                                                              options.dictionary);
+                slot.rawSize = static_cast<uint32_t>(rawSize);
+            }
+            catch(...)
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                failed = true;
+                readyCv.notify_all();
+                throw; // rethrown by pool.wait()
+            }
+            std::lock_guard<std::mutex> lock(mtx);
+            slot.ready = true;
+            readyCv.notify_all();
+        });
+    };
+
+    size_t submitted = 0;
+    for(; submitted < std::min(slots.size(), plan.size()); submitted++) submit(submitted);
+    index.blocks.resize(plan.size());
+    bool writeFailed = false;
+    for(size_t b = 0; b < plan.size(); b++)
+    {
+        Slot &slot = slots[b % slots.size()];
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            readyCv.wait(lock, [&] { return slot.ready || failed; });
+            if(failed) break;
+        }
+        size_t n = slot.compressedSize & ~LZ4Frame::BLOCK_STORED;
+        if(!writeAll(fd, slot.packed.data(), n))
+        {
+            writeFailed = true;
+            break;
+        }
+        index.blocks[b] = {writePos, slot.compressedSize, slot.rawSize};
+        writePos += n;
+        if(options.stats) options.stats->merge(slot.stats);
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            slot.ready = false;
+        }
+        if(submitted < plan.size()) submit(submitted++);
+    }
+    // Tasks still in flight reference the slots; let them finish first.
+    pool.wait();
+    if(writeFailed) throw std::runtime_error("Failed to write output.");
+    return writePos;
+}
+
+size_t LZ4Archive::create(const std::string &root, const std::string &archivePath, const LZ4Frame::Options &options)
+{
+    if(!fs::is_directory(root)) throw std::runtime_error("Not a directory: " + root);
+    size_t blockSize = options.blockSize;
+    if(blockSize == 0 || blockSize > LZ4Frame::MAX_BLOCK_SIZE) throw std::runtime_error("Invalid block size.");
+    WorkStealingPool pool(options.threads);
+
+    std::vector<FileInfo> files;
+    std::mutex filesMtx;
+    fs::path rootPath(root);
+    pool.submit([&] { walkDirectory(pool, rootPath, rootPath, filesMtx, files); });
+    pool.wait();
+    std::sort(files.begin(), files.end(), [](const FileInfo &a, const FileInfo &b) { return a.name < b.name; });
+
+    // Cut the concatenated files into blocks.
+    std::vector<Entry> entries;
+    std::vector<std::vector<Segment>> plan;
+    size_t fill = blockSize; // bytes in the last block of plan
+    for(size_t i = 0; i < files.size(); i++)
+    {
+        Entry entry{files[i].name, files[i].size, 0, 0};
+        for(uint64_t done = 0; done < files[i].size;)
+        {
+            if(fill == blockSize)
+            {
+                plan.emplace_back();
+                fill = 0;
+            }
+            if(done == 0)
+            {
+                entry.firstBlock = static_cast<uint32_t>(plan.size() - 1);
+                entry.offset = static_cast<uint32_t>(fill);
+            }
+            size_t take = static_cast<size_t>(std::min<uint64_t>(files[i].size - done, blockSize - fill));
+            plan.back().push_back({i, done, take});
+            done += take;
+            fill += take;
+        }
+        entries.push_back(std::move(entry));
+    }
+    if(plan.size() > UINT32_MAX || entries.size() > UINT32_MAX) throw std::runtime_error("Too many files for one archive.");
+
+    Index index;
+    index.flags = options.entropy ? LZ4Frame::FLAG_ENTROPY : 0;
+    index.blockSize = blockSize;
+    const LZ4Dictionary *dictionary = options.dictionary;
+    std::vector<uint8_t> header;
+    LZ4Frame::putU32(header, MAGIC);
+    header.push_back(VERSION);
+    if(dictionary) index.flags |= LZ4Frame::FLAG_DICT_ID;
+    header.push_back(index.flags);
+    LZ4Frame::putU32(header, static_cast<uint32_t>(blockSize));
+    if(dictionary) LZ4Frame::putU32(header, dictionary->id());
+
+    // The archive is built in a fresh temporary file next to archivePath
+    // and renamed into place only once complete, so a failed run never
+    // leaves a truncated archive and no existing file is overwritten early.
+    std::string tempPath = archivePath + ".XXXXXX";
+    int fd = ::mkstemp(&tempPath[0]);
+    if(fd < 0) throw std::runtime_error("Cannot create temporary file for: " + archivePath);
+    try
+    {
+        // mkstemp creates the file 0600; give it the usual mode instead.
+        mode_t mask = ::umask(0);
+        ::umask(mask);
+        ::fchmod(fd, 0666 & ~mask);
+        if(!writeAll(fd, header.data(), header.size())) throw std::runtime_error("Failed to write output.");
+        uint64_t indexPos = writeBlocks(pool, fd, header.size(), files, plan, options, index);
+
+        std::vector<uint8_t> tail;
+        LZ4Frame::putU32(tail, static_cast<uint32_t>(index.blocks.size()));
+        for(const Block &block : index.blocks)
+        {
+            LZ4Frame::putU64(tail, block.pos);
+            LZ4Frame::putU32(tail, block.compressedSize);
+            LZ4Frame::putU32(tail, block.rawSize);
+        }
+        LZ4Frame::putU32(tail, static_cast<uint32_t>(entries.size()));
+        for(const Entry &entry : entries)
+        {
+            tail.push_back(entry.name.size() & 0xFF);
+            tail.push_back((entry.name.size() >> 8) & 0xFF);
+            tail.insert(tail.end(), entry.name.begin(), entry.name.end());
+            LZ4Frame::putU64(tail, entry.size);
+            LZ4Frame::putU32(tail, entry.firstBlock);
+            LZ4Frame::putU32(tail, entry.offset);
+        }
+        LZ4Frame::putU64(tail, indexPos);
+        LZ4Frame::putU32(tail, INDEX_MAGIC);
+        bool ok = writeAll(fd, tail.data(), tail.size());
+        if(::close(fd) != 0) ok = false;
+        fd = -1;
+        if(!ok) throw std::runtime_error("Failed to write output.");
+        fs::rename(tempPath, archivePath);
+    }
+    catch(...)
+    {
+        if(fd >= 0) ::close(fd);
+        ::unlink(tempPath.c_str());
+        throw;
+    }
+    return entries.size();
+}
+
+LZ4Archive::Index LZ4Archive::readIndex(const uint8_t *src, size_t srcSize)
+{
+    Index index;
+    if(srcSize < 10 + 12) throw std::runtime_error("Archive too short.");
+    if(LZ4Frame::readU32(src) != MAGIC) throw std::runtime_error("Not an SLZA archive.");
+    if(src[4] != VERSION) throw std::runtime_error("Unsupported archive version.");
+    index.flags = src[5];
+    if(index.flags & ~ARCHIVE_FLAGS) throw std::runtime_error("Unknown archive flags.");
+    index.blockSize = LZ4Frame::readU32(src + 6);
+    if(index.blockSize == 0 || index.blockSize > LZ4Frame::MAX_BLOCK_SIZE) throw std::runtime_error("Invalid block size.");
+    size_t dataStart = 10;
+    if(index.flags & LZ4Frame::FLAG_DICT_ID)
+    {
+        index.dictId = LZ4Frame::readU32(src + dataStart);
+        dataStart += 4;
+    }
+
+    if(LZ4Frame::readU32(src + srcSize - 4) != INDEX_MAGIC) throw std::runtime_error("Missing archive index.");
+    uint64_t indexPos = LZ4Frame::readU64(src + srcSize - 12);
+    if(indexPos < dataStart || indexPos > srcSize - 12) throw std::runtime_error("Archive index out of bounds.");
+    const uint8_t *p = src + indexPos;
+    const uint8_t *const end = src + srcSize - 12;
+    auto need = [&](uint64_t n) {
+        if(n > static_cast<uint64_t>(end - p)) throw std::runtime_error("Unexpected end of archive index.");
+    };
+
+    need(4);
+    uint32_t blockCount = LZ4Frame::readU32(p);
+    p += 4;
+    need(uint64_t(blockCount) * 16);
+    size_t bound = LZ4Frame::blockBound(index.blockSize, index.flags);
+    for(uint32_t b = 0; b < blockCount; b++, p += 16)
+    {
+        Block block{LZ4Frame::readU64(p), LZ4Frame::readU32(p + 8), LZ4Frame::readU32(p + 12)};
+        size_t size = block.compressedSize & ~LZ4Frame::BLOCK_STORED;
+        if(block.rawSize == 0 || block.rawSize > index.blockSize || size > bound) throw std::runtime_error("Invalid block size in archive index.");
+        if(block.pos < dataStart || block.pos > indexPos || size > indexPos - block.pos)
+            throw std::runtime_error("Block extends past archive data.");
+        index.blocks.push_back(block);
+    }
+
+    need(4);
+    uint32_t fileCount = LZ4Frame::readU32(p);
+    p += 4;
+    for(uint32_t i = 0; i < fileCount; i++)
+    {
+        need(2);
+        size_t nameLength = p[0] | (p[1] << 8);
+        p += 2;
+        need(nameLength + 16);
+        Entry entry;
+        entry.name.assign(reinterpret_cast<const char *>(p), nameLength);
+        p += nameLength;
+        entry.size = LZ4Frame::readU64(p);
+        entry.firstBlock = LZ4Frame::readU32(p + 8);
+        entry.offset = LZ4Frame::readU32(p + 12);
+        p += 16;
+        // Extraction looks names up by binary search, and a repeated name
+        // would be written twice.
+        if(!index.entries.empty() && !(index.entries.back().name < entry.name))
+            throw std::runtime_error("Archive index not sorted by name.");
+        index.entries.push_back(std::move(entry));
+    }
+    if(p != end) throw std::runtime_error("Trailing data in archive index.");
+    return index;
+}
+
+// Names come from the archive, so each one is checked before it becomes a
+// path: it must stay relative and below the output directory.
+static void checkName(const std::string &name)
+{
+    bool ok = !name.empty() && name.front() != '/' && name.find('\0') == std::string::npos;
+    for(size_t start = 0; ok && start <= name.size();)
+    {
+        size_t slash = std::min(name.find('/', start), name.size());
+        std::string part = name.substr(start, slash - start);
+        ok = !part.empty() && part != "." && part != "..";
+        start = slash + 1;
+    }
+    if(!ok) throw std::runtime_error("Unsafe file name in archive: " + name);
+}
+
+size_t LZ4Archive::extract(const std::string &archivePath, const std::string &outDir, const std::vector<std::string> &names,
+                           size_t threads, const LZ4Dictionary *dictionary)
+{
+    MappedFile in = MappedFile::openRead(archivePath);
+    Index index = readIndex(in.data(), in.size());
+    LZ4Frame::Header header;
+    header.flags = index.flags;
+    header.dictId = index.dictId;
+    LZ4Frame::checkDictionary(header, dictionary);
+
+    std::vector<size_t> selected;
+    if(names.empty())
+    {
+        for(size_t i = 0; i < index.entries.size(); i++) selected.push_back(i);
+    }
+    else
+    {
+        for(const std::string &name : names)
+        {
+            auto it = std::lower_bound(index.entries.begin(), index.entries.end(), name,
+                                       [](const Entry &e, const std::string &n) { return e.name < n; });
+            if(it == index.entries.end() || it->name != name) throw std::runtime_error("Not in archive: " + name);
+            selected.push_back(static_cast<size_t>(it - index.entries.begin()));
+        }
+        // A name given twice is written and counted once.
+        std::sort(selected.begin(), selected.end());
+        selected.erase(std::unique(selected.begin(), selected.end()), selected.end());
+    }
+
+    // Work out which bytes of which blocks each file needs, and create the
+    // directories (and the empty files, which need no block) up front.
+    std::vector<std::vector<Piece>> pieces(index.blocks.size());
+    std::vector<std::string> paths(index.entries.size());
+    std::set<fs::path> dirs;
+    for(size_t i : selected)
+    {
+        const Entry &entry = index.entries[i];
+        checkName(entry.name);
+        fs::path path = fs::path(outDir) / entry.name;
+        paths[i] = path.string();
+        if(dirs.insert(path.parent_path()).second) fs::create_directories(path.parent_path());
+        if(entry.size == 0)
+        {
+            if(!std::ofstream(paths[i], std::ios::binary)) throw std::runtime_error("Cannot open file: " + paths[i]);
+            continue;
+        }
+        size_t b = entry.firstBlock;
+        size_t offset = entry.offset;
+        for(uint64_t done = 0; done < entry.size; b++, offset = 0)
+        {
+            if(b >= index.blocks.size() || offset >= index.blocks[b].rawSize)
+                throw std::runtime_error("File extends past archive blocks: " + entry.name);
+            size_t take = static_cast<size_t>(std::min<uint64_t>(entry.size - done, index.blocks[b].rawSize - offset));
+            pieces[b].push_back({i, offset, done, take});
+            done += take;
+        }
+    }
+
+    const uint8_t *dict = (index.flags & LZ4Frame::FLAG_DICT_ID) ? dictionary->data() : nullptr;
+    size_t dictSize = dict ? dictionary->size() : 0;
+    const uint8_t *src = in.data();
+    WorkStealingPool pool(threads);
+    for(size_t b = 0; b < index.blocks.size(); b++)
+    {
+        if(pieces[b].empty()) continue;
+        pool.submit([&, b] {
+            thread_local std::vector<uint8_t> raw;
+            const Block &block = index.blocks[b];
+            raw.resize(block.rawSize);
+            bool stored = (block.compressedSize & LZ4Frame::BLOCK_STORED) != 0;
+            size_t written = LZ4Frame::decompressBlock(index.flags, stored, src + block.pos, block.compressedSize & ~LZ4Frame::BLOCK_STORED,
+                                                       raw.data(), raw.size(), 0, dict, dictSize);
+            if(written != block.rawSize) throw std::runtime_error("Block size mismatch during decompression.");
+            for(const Piece &piece : pieces[b])
+                writeAt(paths[piece.entry], index.entries[piece.entry].size, piece.fileOffset, raw.data() + piece.blockOffset, piece.length);
+        });
+    }
+    pool.wait();
+    return selected.size();
+}
@@ -0,0 +1,78 @@
+#ifndef LZ4ARCHIVE_H
+#define LZ4ARCHIVE_H
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include "lz4frame.h"
+
+// Many files in one container with a central index:
+//   magic (u32) | version (u8) | flags (u8) | blockSize (u32)
+//   [dictId (u32), if FLAG_DICT_ID]
+//   { block data }*
+//   index: blockCount (u32) | { pos (u64) | compressedSize (u32) | rawSize (u32) }*
+//          fileCount (u32)  | { nameLength (u16) | name | size (u64) | firstBlock (u32) | offset (u32) }*
+//   indexPos (u64) | INDEX_MAGIC (u32)
+// The files are concatenated in name order and the result is cut into
+// blockSize blocks, so small files share blocks and a file starts offset
+// bytes into its first block and continues into the blocks after it. Blocks
+// are independent LZ4Frame blocks: flags are the frame flags (FLAG_ENTROPY,
+// FLAG_DICT_ID) and compressedSize may carry LZ4Frame::BLOCK_STORED. They are
+// written in index order, so the same tree and options give the same archive
+// bytes for any thread count. Names are relative paths with '/' separators.
+// Listing reads only the trailer and the index; extracting a file decodes
+// only the blocks it spans.
+class LZ4Archive
+{
+public:
+    static constexpr uint32_t MAGIC = 0x415A4C53;       // "SLZA"
+    static constexpr uint32_t INDEX_MAGIC = 0x495A4C53; // "SLZI"
+    static constexpr uint8_t VERSION = 1;
+    static constexpr size_t MAX_NAME_LENGTH = 0xFFFF;
+
+    struct Block
+    {
+        uint64_t pos;            // of the block data in the archive
+        uint32_t compressedSize; // with LZ4Frame::BLOCK_STORED
+        uint32_t rawSize;
+    };
+
+    struct Entry
+    {
+        std::string name;
+        uint64_t size;
+        uint32_t firstBlock;
+        uint32_t offset; // into the raw bytes of firstBlock
+    };
+
+    struct Index
+    {
+        uint8_t flags = 0;
+        size_t blockSize = LZ4Frame::DEFAULT_BLOCK_SIZE;
+        uint32_t dictId = 0; // valid with FLAG_DICT_ID
+        std::vector<Block> blocks;
+        std::vector<Entry> entries; // sorted by name
+    };
+
+    // Archives every regular file under root into archivePath and returns
+    // the number of files. Everything runs on one WorkStealingPool of
+    // options.threads threads (0 = one per hardware thread): the walk, whose
+    // subdirectory tasks stay on the worker that found them unless stolen,
+    // then the blocks, handed out in index order a bounded number ahead of
+    // the writer. options.level, profile, blockSize, entropy, dictionary and
+    // stats apply as for LZ4Frame::compress. The archive is written to a new
+    // temporary file (mkstemp) beside archivePath and renamed when complete;
+    // on failure that file is removed and archivePath is left untouched.
+    static size_t create(const std::string &root, const std::string &archivePath, const LZ4Frame::Options &options);
+
+    // Parses the trailer and index of an archive held in memory.
+    static Index readIndex(const uint8_t *src, size_t srcSize);
+
+    // Writes the named files (every file when names is empty) under outDir,
+    // creating directories as needed, and returns the number written. Blocks
+    // are decoded in parallel, each once however many files it holds. Throws
+    // if a name is not in the archive or would land outside outDir.
+    static size_t extract(const std::string &archivePath, const std::string &outDir, const std::vector<std::string> &names,
+                          size_t threads, const LZ4Dictionary *dictionary = nullptr);
+};
+#endif
@@ -0,0 +1,86 @@
+#include "lz4dict.h"
+#include "lz4.h"
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+constexpr size_t KMER_SIZE = 8;      // substring length counted by the trainer
+constexpr size_t SEGMENT_SIZE = 64;  // unit the trainer copies into the dictionary
+constexpr int KMER_HASH_BITS = 20;
+
+LZ4Dictionary::LZ4Dictionary(const std::vector<uint8_t> &data)
+{
+    size_t keep = std::min(data.size(), MAX_SIZE);
+    content.assign(data.end() - keep, data.end());
+    table = SimpleLZ4::buildHashTable(content.data(), content.size());
+
+    // FNV-1a over the content; 0 is reserved for "no dictionary".
+    uint32_t h = 2166136261u;
+    for(uint8_t c : content) h = (h ^ c) * 16777619u;
+    dictId = h ? h : 1;
+}
+
+LZ4Dictionary LZ4Dictionary::load(const std::string &path)
+{
+    std::ifstream in(path, std::ios::binary);
+    if(!in) throw std::runtime_error("Cannot open dictionary : " + path);
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    return LZ4Dictionary(data);
+}
+
+static inline uint32_t kmerHash(const uint8_t *p)
+{
+    uint64_t v = 0;
+    for(size_t i = 0; i < KMER_SIZE; i++) v = (v << 8) | p[i];
+    return static_cast<uint32_t>((v * 0x9E3779B97F4A7C15ull) >> (64 - KMER_HASH_BITS));
+}
+
+std::vector<uint8_t> LZ4Dictionary::train(const std::vector<std::vector<uint8_t>> &samples, size_t maxSize)
+{
+    maxSize = std::min(maxSize, MAX_SIZE);
+    std::vector<uint8_t> corpus;
+    for(const auto &s : samples) corpus.insert(corpus.end(), s.begin(), s.end());
+    if(corpus.size() <= maxSize) return corpus;
+
+    // How often each substring occurs across the whole corpus.
+    std::vector<uint32_t> freq(size_t(1) << KMER_HASH_BITS, 0);
+    for(size_t p = 0; p + KMER_SIZE <= corpus.size(); p++) freq[kmerHash(&corpus[p])]++;
+
+    // Split the corpus into one epoch per segment and take the best-scoring
+    // segment of each. Substrings already taken stop scoring, so later
+    // segments bring in new content instead of repeating earlier ones.
+    size_t segments = std::max<size_t>(1, maxSize / SEGMENT_SIZE);
+    size_t epochSize = std::max(corpus.size() / segments, SEGMENT_SIZE + KMER_SIZE);
+    std::vector<std::pair<uint64_t, size_t>> chosen; // (score, start)
+    for(size_t epoch = 0; epoch + SEGMENT_SIZE + KMER_SIZE <= corpus.size(); epoch += epochSize)
+    {
+        size_t epochEnd = std::min(corpus.size(), epoch + epochSize) - KMER_SIZE;
+        if(epochEnd < epoch + SEGMENT_SIZE) break;
+        uint64_t score = 0;
+        for(size_t p = epoch; p < epoch + SEGMENT_SIZE; p++) score += freq[kmerHash(&corpus[p])];
+        uint64_t bestScore = score;
+        size_t bestStart = epoch;
+        for(size_t start = epoch + 1; start + SEGMENT_SIZE <= epochEnd; start++)
+        {
+            score -= freq[kmerHash(&corpus[start - 1])];
+            score += freq[kmerHash(&corpus[start + SEGMENT_SIZE - 1])];
+            if(score > bestScore)
+            {
+                bestScore = score;
+                bestStart = start;
+            }
+        }
+        if(bestScore == 0) continue;
+        for(size_t p = bestStart; p < bestStart + SEGMENT_SIZE; p++) freq[kmerHash(&corpus[p])] = 0;
+        chosen.push_back({bestScore, bestStart});
+    }
+
+    // Best segments go last, where offsets from the input are smallest.
+    std::stable_sort(chosen.begin(), chosen.end());
+    std::vector<uint8_t> dict;
+    for(const auto &c : chosen)
+        dict.insert(dict.end(), corpus.begin() + c.second, corpus.begin() + c.second + SEGMENT_SIZE);
+    if(dict.size() > maxSize) dict.erase(dict.begin(), dict.end() - maxSize);
+    return dict;
+}
@@ -0,0 +1,36 @@
+#ifndef LZ4DICT_H
+#define LZ4DICT_H
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// Preset dictionary: content that compress and decompress treat as history
+// before the first byte, so short inputs can match against it. The fast-level
+// hash table over the content is built once here and reused by every call.
+class LZ4Dictionary
+{
+public:
+    static constexpr size_t MAX_SIZE = 65535; // only the last 64KB is reachable
+    static constexpr size_t DEFAULT_TRAINED_SIZE = 1 << 14;
+
+    // Keeps at most the last MAX_SIZE bytes of content.
+    explicit LZ4Dictionary(const std::vector<uint8_t> &content);
+    static LZ4Dictionary load(const std::string &path);
+
+    const uint8_t *data() const { return content.data(); }
+    size_t size() const { return content.size(); }
+    // Stored in frames so a decoder can check it has the right dictionary.
+    uint32_t id() const { return dictId; }
+    const std::vector<int> &hashTable() const { return table; }
+
+    // Builds a dictionary of at most maxSize bytes from sample inputs by
+    // keeping the segments whose 8-byte substrings recur most often.
+    static std::vector<uint8_t> train(const std::vector<std::vector<uint8_t>> &samples, size_t maxSize = DEFAULT_TRAINED_SIZE);
+
+private:
+    std::vector<uint8_t> content;
+    std::vector<int> table;
+    uint32_t dictId;
+};
+#endif
@@ -0,0 +1,216 @@
+#include "lz4entropy.h"
+#include "lz4frame.h"
+#include "../HuffmanCoding/HuffmanCoding.hpp"
+#include "../TANSCoding/TANSCoding.hpp"
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+enum StreamId { TOKENS, LITERALS, LENGTHS, OFFSETS_LOW, OFFSETS_HIGH };
+
+// Streams shorter than this are stored: a code table would cost more than
+// it saves.
+constexpr size_t MIN_CODED_STREAM = 64;
+
+// The coder behind a stream's size word: Huffman when no flag is set.
+static const EntropyCoder &streamCoder(uint32_t word)
+{
+    return (word & LZ4Entropy::STREAM_TANS) ? TANSCoding::entropyCoder() : HuffmanCoding::entropyCoder();
+}
+
+static void splitLength(const uint8_t *&ip, const uint8_t *iend, std::vector<uint8_t> &lengths, size_t &length)
+{
+    uint8_t s;
+    do {
+        if(ip >= iend) throw std::runtime_error("Unexpected end of input when reading length.");
+        s = *ip++;
+        lengths.push_back(s);
+        length += s;
+    } while(s == 255);
+}
+
+// Walks the tokens of an LZ4 block and appends each part to its stream.
+static void splitBlock(const uint8_t *src, size_t srcSize, std::vector<uint8_t> (&streams)[LZ4Entropy::STREAM_COUNT])
+{
+    for(auto &s : streams) s.clear();
+    const uint8_t *ip = src;
+    const uint8_t *const iend = src + srcSize;
+    while(ip < iend)
+    {
+        unsigned token = *ip++;
+        streams[TOKENS].push_back(static_cast<uint8_t>(token));
+        size_t length = token >> 4;
+        if(length == 15) splitLength(ip, iend, streams[LENGTHS], length);
+        if(length > static_cast<size_t>(iend - ip)) throw std::runtime_error("Literal length out of bounds in LZ4 block.");
+        streams[LITERALS].insert(streams[LITERALS].end(), ip, ip + length);
+        ip += length;
+        if(ip == iend) break;
+        if(iend - ip < 2) throw std::runtime_error("Unexpected end of input when reading offset.");
+        streams[OFFSETS_LOW].push_back(ip[0]);
+        streams[OFFSETS_HIGH].push_back(ip[1]);
+        ip += 2;
+        length = 0;
+        if((token & 0x0F) == 15) splitLength(ip, iend, streams[LENGTHS], length);
+    }
+}
+
+size_t LZ4Entropy::encode(const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstCapacity)
+{
+    if(dstCapacity < encodeBound(srcSize)) throw std::runtime_error("Output buffer too small for entropy coding.");
+
+    // Scratch buffers are kept per thread, so frame blocks coded on a pool
+    // stop allocating once they have grown to the block size.
+    thread_local std::vector<uint8_t> streams[STREAM_COUNT];
+    thread_local std::vector<uint8_t> packed;
+    thread_local std::vector<uint8_t> coded;
+    splitBlock(src, srcSize, streams);
+
+    packed.assign(5, 0);
+    packed[0] = MODE_SPLIT;
+    LZ4Frame::writeU32(packed.data() + 1, static_cast<uint32_t>(srcSize));
+    for(const auto &stream : streams)
+    {
+        size_t headerPos = packed.size();
+        packed.resize(headerPos + 4);
+        // Each coded stream takes whichever coder gives the smaller output:
+        // tANS wins on skewed streams such as tokens and lengths, Huffman
+        // on flat ones, where it is the faster of the two to decode.
+        size_t codedSize = SIZE_MAX;
+        uint32_t coderFlag = 0;
+        coded.clear();
+        if(stream.size() >= MIN_CODED_STREAM)
+        {
+            for(uint32_t flag : {0u, STREAM_TANS})
+            {
+                const EntropyCoder &coder = streamCoder(flag);
+                size_t at = coded.size();
+                coded.resize(at + coder.compressBound(stream.size()));
+                size_t n = coder.compress(stream.data(), stream.size(), coded.data() + at, coded.size() - at);
+                if(n < codedSize)
+                {
+                    if(at) std::memmove(coded.data(), coded.data() + at, n);
+                    codedSize = n;
+                    coderFlag = flag;
+                }
+                coded.resize(codedSize);
+            }
+        }
+        if(codedSize < stream.size())
+        {
+            LZ4Frame::writeU32(packed.data() + headerPos, static_cast<uint32_t>(codedSize) | coderFlag);
+            packed.insert(packed.end(), coded.begin(), coded.begin() + codedSize);
+        }
+        else
+        {
+            LZ4Frame::writeU32(packed.data() + headerPos, static_cast<uint32_t>(stream.size()) | STREAM_STORED);
+            packed.insert(packed.end(), stream.begin(), stream.end());
+        }
+    }
+
+    if(packed.size() < 1 + srcSize)
+    {
+        std::memcpy(dst, packed.data(), packed.size());
+        return packed.size();
+    }
+    dst[0] = MODE_STORED;
+    if(srcSize) std::memcpy(dst + 1, src, srcSize);
+    return 1 + srcSize;
+}
+
+size_t LZ4Entropy::decodedSize(const uint8_t *src, size_t srcSize)
+{
+    if(srcSize < 1) throw std::runtime_error("Empty entropy-coded block.");
+    if(src[0] == MODE_STORED) return srcSize - 1;
+    if(src[0] != MODE_SPLIT) throw std::runtime_error("Unknown entropy block mode.");
+    if(srcSize < 5) throw std::runtime_error("Unexpected end of entropy-coded block.");
+    return LZ4Frame::readU32(src + 1);
+}
+
+static void joinLength(const uint8_t *&lp, const uint8_t *lend, uint8_t *&op, const uint8_t *oend, size_t &length)
+{
+    uint8_t s;
+    do {
+        if(lp == lend || op == oend) throw std::runtime_error("Length stream out of bounds during decompression.");
+        s = *lp++;
+        *op++ = s;
+        length += s;
+    } while(s == 255);
+}
+
+size_t LZ4Entropy::decode(const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstCapacity)
+{
+    size_t lz4Size = decodedSize(src, srcSize);
+    if(lz4Size > dstCapacity) throw std::runtime_error("Output buffer too small during decompression.");
+    if(src[0] == MODE_STORED)
+    {
+        if(lz4Size) std::memcpy(dst, src + 1, lz4Size);
+        return lz4Size;
+    }
+
+    // Stored streams are read in place; coded ones are expanded into
+    // per-thread buffers first. The streams partition the LZ4 block, so
+    // together they may expand to at most lz4Size bytes.
+    thread_local std::vector<uint8_t> buffers[STREAM_COUNT];
+    const uint8_t *begin[STREAM_COUNT];
+    const uint8_t *end[STREAM_COUNT];
+    size_t pos = 5;
+    size_t remaining = lz4Size;
+    for(int k = 0; k < STREAM_COUNT; k++)
+    {
+        if(srcSize - pos < 4) throw std::runtime_error("Unexpected end of entropy-coded block.");
+        uint32_t word = LZ4Frame::readU32(src + pos);
+        pos += 4;
+        size_t size = word & ~(STREAM_STORED | STREAM_TANS);
+        if(size > srcSize - pos) throw std::runtime_error("Stream extends past end of block.");
+        if(word & STREAM_STORED)
+        {
+            if(size > remaining) throw std::runtime_error("Streams larger than their block.");
+            remaining -= size;
+            begin[k] = src + pos;
+            end[k] = src + pos + size;
+        }
+        else
+        {
+            const EntropyCoder &coder = streamCoder(word);
+            size_t n = coder.decompressedSize(src + pos, size);
+            if(n > remaining) throw std::runtime_error("Streams larger than their block.");
+            remaining -= n;
+            buffers[k].resize(n);
+            coder.decompress(src + pos, size, buffers[k].data(), n);
+            begin[k] = buffers[k].data();
+            end[k] = begin[k] + n;
+        }
+        pos += size;
+    }
+    if(end[OFFSETS_LOW] - begin[OFFSETS_LOW] != end[OFFSETS_HIGH] - begin[OFFSETS_HIGH])
+        throw std::runtime_error("Offset streams differ in length.");
+
+    const uint8_t *tp = begin[TOKENS], *lit = begin[LITERALS], *lp = begin[LENGTHS];
+    const uint8_t *lo = begin[OFFSETS_LOW], *hi = begin[OFFSETS_HIGH];
+    uint8_t *op = dst;
+    const uint8_t *const oend = dst + lz4Size;
+    while(tp < end[TOKENS])
+    {
+        if(op == oend) throw std::runtime_error("Token stream out of bounds during decompression.");
+        unsigned token = *tp++;
+        *op++ = static_cast<uint8_t>(token);
+        size_t length = token >> 4;
+        if(length == 15) joinLength(lp, end[LENGTHS], op, oend, length);
+        if(length > static_cast<size_t>(end[LITERALS] - lit) || length > static_cast<size_t>(oend - op))
+            throw std::runtime_error("Literal length out of bounds during decompression.");
+        if(length) std::memcpy(op, lit, length);
+        op += length;
+        lit += length;
+
+        // Only the last sequence may lack a match, and then no offsets remain.
+        if(tp == end[TOKENS] && lo == end[OFFSETS_LOW]) break;
+        if(lo == end[OFFSETS_LOW] || oend - op < 2) throw std::runtime_error("Offset stream out of bounds during decompression.");
+        *op++ = *lo++;
+        *op++ = *hi++;
+        length = 0;
+        if((token & 0x0F) == 15) joinLength(lp, end[LENGTHS], op, oend, length);
+    }
+    if(op != oend || lit != end[LITERALS] || lp != end[LENGTHS] || lo != end[OFFSETS_LOW])
+        throw std::runtime_error("Entropy streams do not match block size.");
+    return lz4Size;
+}
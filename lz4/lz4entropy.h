@@ -0,0 +1,40 @@
+#ifndef LZ4ENTROPY_H
+#define LZ4ENTROPY_H
+#include <cstdint>
+#include <cstddef>
+
+// Entropy stage for SimpleLZ4 blocks. An LZ4 block interleaves sequence
+// tokens, literal bytes, length extension bytes and 2-byte offsets, whose
+// statistics have little in common; here each kind is split into its own
+// stream and entropy-coded with a table built for that stream alone:
+//   mode (u8)
+//   MODE_STORED: the LZ4 block as is
+//   MODE_SPLIT:  lz4Size (u32) | { streamSize (u32, | flag) | data }*
+// with streams in the order tokens, literals, lengths, offset low bytes,
+// offset high bytes. A stream flagged STREAM_STORED is raw bytes, one
+// flagged STREAM_TANS is TANSCoding::compress() output, and one with
+// neither is HuffmanCoding::compress() output. Decoding rebuilds the original
+// LZ4 block byte for byte, so the match stage is left untouched.
+class LZ4Entropy
+{
+public:
+    static constexpr uint8_t MODE_STORED = 0;
+    static constexpr uint8_t MODE_SPLIT = 1;
+    static constexpr uint32_t STREAM_STORED = 0x80000000u;
+    static constexpr uint32_t STREAM_TANS = 0x40000000u;
+    static constexpr int STREAM_COUNT = 5;
+
+    // Largest encode() output for an LZ4 block of n bytes.
+    static constexpr size_t encodeBound(size_t n) { return n + 1; }
+
+    // Re-codes the LZ4 block src and returns the size written to dst, which
+    // must hold encodeBound(srcSize) bytes. Falls back to MODE_STORED when
+    // splitting does not pay off. Throws on a malformed block.
+    static size_t encode(const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstCapacity);
+    // Size of the LZ4 block that decode() rebuilds.
+    static size_t decodedSize(const uint8_t *src, size_t srcSize);
+    // Rebuilds the LZ4 block into dst and returns its size. Throws on
+    // malformed input or if dstCapacity is below decodedSize().
+    static size_t decode(const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstCapacity);
+};
+#endif
@@ -0,0 +1,415 @@
+#include "lz4frame.h"
+#include "lz4entropy.h"
+#include "../common/thread_pool.h"
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <algorithm>
+#include <cstring>
+
+void LZ4Frame::putU32(std::vector<uint8_t> &out, uint32_t v)
+{
+    out.push_back(v & 0xFF);
+    out.push_back((v >> 8) & 0xFF);
+    out.push_back((v >> 16) & 0xFF);
+    out.push_back((v >> 24) & 0xFF);
+}
+
+void LZ4Frame::putU64(std::vector<uint8_t> &out, uint64_t v)
+{
+    putU32(out, static_cast<uint32_t>(v));
+    putU32(out, static_cast<uint32_t>(v >> 32));
+}
+
+uint32_t LZ4Frame::readU32(const uint8_t *p)
+{
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+uint64_t LZ4Frame::readU64(const uint8_t *p)
+{
+    return static_cast<uint64_t>(readU32(p)) | (static_cast<uint64_t>(readU32(p + 4)) << 32);
+}
+
+void LZ4Frame::writeU32(uint8_t *p, uint32_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = (v >> 24) & 0xFF;
+}
+
+void LZ4Frame::writeHeader(std::vector<uint8_t> &out, const Header &header)
+{
+    if(header.blockSize == 0 || header.blockSize > MAX_BLOCK_SIZE) throw std::runtime_error("Invalid block size.");
+    putU32(out, MAGIC);
+    out.push_back(VERSION);
+    out.push_back(header.flags);
+    putU32(out, static_cast<uint32_t>(header.blockSize));
+    if(header.flags & FLAG_CONTENT_SIZE) putU64(out, header.contentSize);
+    if(header.flags & FLAG_DICT_ID) putU32(out, header.dictId);
+}
+
+size_t LZ4Frame::readHeader(const uint8_t *p, size_t avail, Header &header)
+{
+    if(avail < HEADER_SIZE) return 0;
+    if(readU32(p) != MAGIC) throw std::runtime_error("Not an SLZ4 frame.");
+    if(p[4] != VERSION) throw std::runtime_error("Unsupported frame version.");
+    header.flags = p[5];
+    if(header.flags & ~(FLAG_LINKED_BLOCKS | FLAG_CONTENT_SIZE | FLAG_DICT_ID | FLAG_SEEK_TABLE | FLAG_ENTROPY)) throw std::runtime_error("Unknown frame flags.");
+    header.blockSize = readU32(p + 6);
+    if(header.blockSize == 0 || header.blockSize > MAX_BLOCK_SIZE) throw std::runtime_error("Invalid block size.");
+    size_t len = HEADER_SIZE;
+    if(header.flags & FLAG_CONTENT_SIZE)
+    {
+        if(avail < len + 8) return 0;
+        header.contentSize = readU64(p + len);
+        len += 8;
+    }
+    if(header.flags & FLAG_DICT_ID)
+    {
+        if(avail < len + 4) return 0;
+        header.dictId = readU32(p + len);
+        len += 4;
+    }
+    return len;
+}
+
+void LZ4Frame::checkDictionary(const Header &header, const LZ4Dictionary *dictionary)
+{
+    if(!(header.flags & FLAG_DICT_ID)) return;
+    if(!dictionary) throw std::runtime_error("Frame requires dictionary " + std::to_string(header.dictId) + ".");
+    if(dictionary->id() != header.dictId) throw std::runtime_error("Dictionary ID does not match frame.");
+}
+
+size_t LZ4Frame::blockBound(size_t rawSize, uint8_t flags)
+{
+    size_t bound = SimpleLZ4::compressBound(rawSize);
+    return (flags & FLAG_ENTROPY) ? LZ4Entropy::encodeBound(bound) : bound;
+}
+
+uint32_t LZ4Frame::compressBlock(SimpleLZ4 &codec, LZ4Context &ctx, uint8_t flags, const uint8_t *src, size_t rawSize, uint8_t *dst,
+                                 size_t prefixLen, const LZ4Dictionary *dictionary)
+{
+    // With the entropy stage the LZ4 block goes to a per-thread buffer first
+    // and is re-coded from there into dst.
+    thread_local std::vector<uint8_t> lz4Block;
+    bool entropy = flags & FLAG_ENTROPY;
+    size_t bound = SimpleLZ4::compressBound(rawSize);
+    if(entropy) lz4Block.resize(bound);
+    uint8_t *out = entropy ? lz4Block.data() : dst;
+    size_t size = dictionary ? codec.compress(ctx, src, rawSize, out, bound, *dictionary)
+                             : codec.compress(ctx, src, rawSize, out, bound, prefixLen);
+    if(entropy && size < rawSize) size = LZ4Entropy::encode(out, size, dst, LZ4Entropy::encodeBound(size));
+    if(size < rawSize) return static_cast<uint32_t>(size);
+    std::memcpy(dst, src, rawSize);
+    return static_cast<uint32_t>(rawSize) | BLOCK_STORED;
+}
+
+size_t LZ4Frame::decompressBlock(uint8_t flags, bool stored, const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstCapacity,
+                                 size_t prefixLen, const uint8_t *extDict, size_t extDictSize)
+{
+    if(stored)
+    {
+        if(srcSize > dstCapacity) throw std::runtime_error("Output buffer too small during decompression.");
+        std::memcpy(dst, src, srcSize);
+        return srcSize;
+    }
+    if(!(flags & FLAG_ENTROPY))
+        return SimpleLZ4::decompressBlock(src, srcSize, dst, dstCapacity, prefixLen, extDict, extDictSize);
+    // The LZ4 block size comes from the input; an LZ4 block that decodes
+    // into dstCapacity bytes is never larger than compressBound of that, so
+    // anything above is rejected before it is allocated.
+    size_t lz4Size = LZ4Entropy::decodedSize(src, srcSize);
+    if(lz4Size > SimpleLZ4::compressBound(dstCapacity)) throw std::runtime_error("Entropy-coded block larger than its output.");
+    thread_local std::vector<uint8_t> block;
+    block.resize(lz4Size);
+    LZ4Entropy::decode(src, srcSize, block.data(), block.size());
+    return SimpleLZ4::decompressBlock(block.data(), block.size(), dst, dstCapacity, prefixLen, extDict, extDictSize);
+}
+
+bool LZ4Frame::isFrame(const uint8_t *src, size_t srcSize)
+{
+    return srcSize >= 4 && readU32(src) == MAGIC;
+}
+
+bool LZ4Frame::isFrame(const std::vector<uint8_t> &data)
+{
+    return isFrame(data.data(), data.size());
+}
+
+size_t LZ4Frame::compressBound(size_t srcSize, const Options &options)
+{
+    size_t fullBlocks = srcSize / options.blockSize;
+    size_t tail = srcSize % options.blockSize;
+    uint8_t flags = options.entropy ? FLAG_ENTROPY : 0;
+    size_t bound = HEADER_SIZE + 8 + 4 + 4; // header, content size, dictionary ID, end mark
+    bound += fullBlocks * (8 + blockBound(options.blockSize, flags));
+    if(tail) bound += 8 + blockBound(tail, flags);
+    if(options.seekTable) bound += (fullBlocks + (tail ? 1 : 0)) * 8 + 8;
+    return bound;
+}
+
+size_t LZ4Frame::compress(const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstCapacity, const Options &options)
+{
+    size_t blockSize = options.blockSize;
+    SimpleLZ4::Level level = options.level;
+    SimpleLZ4::Profile profile = options.profile;
+    const LZ4Dictionary *dictionary = options.dictionary;
+    if(dstCapacity < compressBound(srcSize, options)) throw std::runtime_error("Output buffer smaller than compressBound.");
+
+    Header header;
+    header.flags = FLAG_CONTENT_SIZE;
+    header.blockSize = blockSize;
+    header.contentSize = srcSize;
+    if(options.seekTable) header.flags |= FLAG_SEEK_TABLE;
+    if(options.entropy) header.flags |= FLAG_ENTROPY;
+    if(dictionary)
+    {
+        header.flags |= FLAG_DICT_ID;
+        header.dictId = dictionary->id();
+    }
+    std::vector<uint8_t> headerBytes;
+    writeHeader(headerBytes, header);
+    std::memcpy(dst, headerBytes.data(), headerBytes.size());
+
+    // Each block is compressed into its own worst-case slot of dst, then moved
+    // down to its final offset once every earlier block is in place. A block's
+    // final position never passes its slot, so the move cannot touch a slot
+    // that is still being written, and no scratch buffers are needed.
+    size_t slotSize = 8 + blockBound(blockSize, header.flags);
+    uint8_t flags = header.flags;
+    size_t slotBase = headerBytes.size();
+    ThreadPool pool(options.threads);
+    std::vector<std::future<size_t>> blocks;
+    size_t blockCount = (srcSize + blockSize - 1) / blockSize;
+    // Each block counts into its own stats, merged below in block order.
+    std::vector<LZ4Stats> blockStats(options.stats ? blockCount : 0);
+    for(size_t i = 0; i < blockCount; i++)
+    {
+        size_t start = i * blockSize;
+        size_t len = std::min(blockSize, srcSize - start);
+        uint8_t *slot = dst + slotBase + i * slotSize;
+        LZ4Stats *stats = options.stats ? &blockStats[i] : nullptr;
+        blocks.push_back(pool.submit([src, start, len, slot, level, profile, dictionary, stats, flags] {
+            SimpleLZ4 codec(level, profile);
+            codec.setStats(stats);
+            thread_local LZ4Context context;
+            uint32_t compressedSize = compressBlock(codec, context, flags, src + start, len, slot + 8, 0, dictionary);
+            writeU32(slot, compressedSize);
+            writeU32(slot + 4, static_cast<uint32_t>(len));
+            return size_t(8) + (compressedSize & ~BLOCK_STORED);
+        }));
+    }
+
+    // Blocks are placed in submission order, so the frame layout does not
+    // depend on which worker finished first.
+    uint8_t *op = dst + slotBase;
+    std::vector<uint32_t> compressedSizes(blockCount);
+    for(size_t i = 0; i < blockCount; i++)
+    {
+        size_t blockBytes = blocks[i].get();
+        uint8_t *slot = dst + slotBase + i * slotSize;
+        if(op != slot) std::memmove(op, slot, blockBytes);
+        compressedSizes[i] = readU32(op); // with BLOCK_STORED
+        op += blockBytes;
+        if(options.stats) options.stats->merge(blockStats[i]);
+    }
+    writeU32(op, 0); // end mark
+    op += 4;
+
+    if(options.seekTable)
+    {
+        for(size_t i = 0; i < blockCount; i++)
+        {
+            writeU32(op, compressedSizes[i]);
+            writeU32(op + 4, static_cast<uint32_t>(std::min(blockSize, srcSize - i * blockSize)));
+            op += 8;
+        }
+        writeU32(op, static_cast<uint32_t>(blockCount));
+        writeU32(op + 4, SEEK_MAGIC);
+        op += 8;
+    }
+    return static_cast<size_t>(op - dst);
+}
+
+std::vector<uint8_t> LZ4Frame::compress(const std::vector<uint8_t> &input, const Options &options)
+{
+    std::vector<uint8_t> output(compressBound(input.size(), options));
+    output.resize(compress(input.data(), input.size(), output.data(), output.size(), options));
+    return output;
+}
+
+namespace {
+struct BlockInfo { size_t srcPos, srcLen, dstPos, dstLen; bool stored; };
+}
+
+// Walks the block headers of a frame without decoding anything.
+static size_t scanBlocks(const uint8_t *src, size_t srcSize, LZ4Frame::Header &header, std::vector<BlockInfo> &infos)
+{
+    size_t pos = LZ4Frame::readHeader(src, srcSize, header);
+    if(pos == 0) throw std::runtime_error("Unexpected end of frame.");
+
+    size_t total = 0;
+    while(true)
+    {
+        if(srcSize - pos < 4) throw std::runtime_error("Unexpected end of frame.");
+        uint32_t word = LZ4Frame::readU32(src + pos);
+        pos += 4;
+        if(word == 0) break;
+        size_t compressedSize = word & ~LZ4Frame::BLOCK_STORED;
+        if(srcSize - pos < 4) throw std::runtime_error("Unexpected end of frame.");
+        uint32_t rawSize = LZ4Frame::readU32(src + pos);
+        pos += 4;
+        if(rawSize > header.blockSize) throw std::runtime_error("Block larger than frame block size.");
+        if(compressedSize > srcSize - pos) throw std::runtime_error("Block extends past end of frame.");
+        infos.push_back({pos, compressedSize, total, rawSize, (word & LZ4Frame::BLOCK_STORED) != 0});
+        pos += compressedSize;
+        total += rawSize;
+    }
+    if((header.flags & LZ4Frame::FLAG_CONTENT_SIZE) && total != header.contentSize)
+        throw std::runtime_error("Frame content size mismatch.");
+    return total;
+}
+
+// Rebuilds the block list from the seek table at the end of the frame. Each
+// entry is checked against the block header it points at, and the entries
+// must end exactly at the end mark, so a table that disagrees with the
+// frame is rejected rather than trusted.
+static void readSeekTable(const uint8_t *src, size_t srcSize, const LZ4Frame::Header &header, size_t headerLen,
+                          std::vector<BlockInfo> &infos)
+{
+    if(srcSize < headerLen + 12) throw std::runtime_error("Frame too short for a seek table.");
+    if(LZ4Frame::readU32(src + srcSize - 4) != LZ4Frame::SEEK_MAGIC) throw std::runtime_error("Missing seek table.");
+    size_t count = LZ4Frame::readU32(src + srcSize - 8);
+    if(count > (srcSize - headerLen - 12) / 8) throw std::runtime_error("Seek table larger than frame.");
+    const uint8_t *entry = src + srcSize - 8 - count * 8;
+    size_t endMark = static_cast<size_t>(entry - src) - 4; // blocks lie in [headerLen, endMark)
+
+    size_t pos = headerLen;
+    size_t total = 0;
+    for(size_t i = 0; i < count; i++, entry += 8)
+    {
+        uint32_t word = LZ4Frame::readU32(entry);
+        size_t compressedSize = word & ~LZ4Frame::BLOCK_STORED;
+        size_t rawSize = LZ4Frame::readU32(entry + 4);
+        if(rawSize > header.blockSize) throw std::runtime_error("Block larger than frame block size.");
+        if(endMark - pos < 8) throw std::runtime_error("Block extends past end of frame.");
+        if(word == 0 || LZ4Frame::readU32(src + pos) != word || LZ4Frame::readU32(src + pos + 4) != rawSize)
+            throw std::runtime_error("Seek table does not match frame.");
+        pos += 8; // block header
+        if(compressedSize > endMark - pos) throw std::runtime_error("Block extends past end of frame.");
+        infos.push_back({pos, compressedSize, total, rawSize, (word & LZ4Frame::BLOCK_STORED) != 0});
+        pos += compressedSize;
+        total += rawSize;
+    }
+    if(pos != endMark || LZ4Frame::readU32(src + endMark) != 0) throw std::runtime_error("Seek table does not match frame.");
+    if((header.flags & LZ4Frame::FLAG_CONTENT_SIZE) && total != header.contentSize)
+        throw std::runtime_error("Frame content size mismatch.");
+}
+
+size_t LZ4Frame::decompressRange(const uint8_t *src, size_t srcSize, uint64_t offset, size_t length, uint8_t *dst,
+                                 size_t dstCapacity, size_t threads, const LZ4Dictionary *dictionary)
+{
+    Header header;
+    size_t headerLen = readHeader(src, srcSize, header);
+    if(headerLen == 0) throw std::runtime_error("Unexpected end of frame.");
+    if(header.flags & FLAG_LINKED_BLOCKS) throw std::runtime_error("Linked frames do not support range reads.");
+    checkDictionary(header, dictionary);
+
+    std::vector<BlockInfo> infos;
+    if(header.flags & FLAG_SEEK_TABLE)
+        readSeekTable(src, srcSize, header, headerLen, infos);
+    else
+        scanBlocks(src, srcSize, header, infos);
+
+    uint64_t total = infos.empty() ? 0 : infos.back().dstPos + infos.back().dstLen;
+    if(offset >= total) return 0;
+    length = static_cast<size_t>(std::min<uint64_t>(length, total - offset));
+    if(length > dstCapacity) throw std::runtime_error("Output buffer too small during decompression.");
+    uint64_t end = offset + length;
+
+    const uint8_t *dict = (header.flags & FLAG_DICT_ID) ? dictionary->data() : nullptr;
+    size_t dictSize = dict ? dictionary->size() : 0;
+    auto first = std::upper_bound(infos.begin(), infos.end(), offset,
+                                  [](uint64_t off, const BlockInfo &b) { return off < b.dstPos + b.dstLen; });
+
+    ThreadPool pool(threads);
+    std::vector<std::future<void>> pending;
+    for(auto it = first; it != infos.end() && it->dstPos < end; ++it)
+    {
+        BlockInfo info = *it;
+        uint8_t flags = header.flags;
+        pending.push_back(pool.submit([src, dst, dict, dictSize, info, offset, end, flags] {
+            uint64_t from = std::max<uint64_t>(offset, info.dstPos);
+            uint64_t to = std::min<uint64_t>(end, info.dstPos + info.dstLen);
+            uint8_t *out = dst + (from - offset);
+            if(from == info.dstPos && to == info.dstPos + info.dstLen)
+            {
+                // Whole block inside the range: decode in place.
+                if(decompressBlock(flags, info.stored, src + info.srcPos, info.srcLen, out, info.dstLen, 0, dict, dictSize) != info.dstLen)
+                    throw std::runtime_error("Block size mismatch during decompression.");
+                return;
+            }
+            std::vector<uint8_t> block(info.dstLen);
+            if(decompressBlock(flags, info.stored, src + info.srcPos, info.srcLen, block.data(), block.size(), 0, dict, dictSize) != info.dstLen)
+                throw std::runtime_error("Block size mismatch during decompression.");
+            std::memcpy(out, block.data() + (from - info.dstPos), to - from);
+        }));
+    }
+    for(auto &f : pending) f.get();
+    return length;
+}
+
+uint64_t LZ4Frame::decompressedSize(const uint8_t *src, size_t srcSize)
+{
+    Header header;
+    size_t headerLen = readHeader(src, srcSize, header);
+    if(headerLen == 0) throw std::runtime_error("Unexpected end of frame.");
+    std::vector<BlockInfo> infos;
+    if(!(header.flags & FLAG_SEEK_TABLE)) return scanBlocks(src, srcSize, header, infos);
+    readSeekTable(src, srcSize, header, headerLen, infos);
+    return infos.empty() ? 0 : infos.back().dstPos + infos.back().dstLen;
+}
+
+size_t LZ4Frame::decompress(const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstCapacity, size_t threads,
+                            const LZ4Dictionary *dictionary)
+{
+    Header header;
+    std::vector<BlockInfo> infos;
+    size_t total = scanBlocks(src, srcSize, header, infos);
+    if(total > dstCapacity) throw std::runtime_error("Output buffer too small during decompression.");
+    checkDictionary(header, dictionary);
+    const uint8_t *dict = (header.flags & FLAG_DICT_ID) ? dictionary->data() : nullptr;
+    size_t dictSize = dict ? dictionary->size() : 0;
+
+    // Every block decodes straight into its final place in dst.
+    uint8_t flags = header.flags;
+    auto decodeBlock = [src, dst, dict, dictSize, flags](const BlockInfo &info, size_t prefixLen) {
+        size_t written = decompressBlock(flags, info.stored, src + info.srcPos, info.srcLen, dst + info.dstPos, info.dstLen,
+                                         prefixLen, dict, dictSize);
+        if(written != info.dstLen) throw std::runtime_error("Block size mismatch during decompression.");
+    };
+
+    if(header.flags & FLAG_LINKED_BLOCKS)
+    {
+        // Linked blocks depend on the output before them, so decode in order.
+        for(const BlockInfo &info : infos) decodeBlock(info, info.dstPos);
+        return total;
+    }
+
+    ThreadPool pool(threads);
+    std::vector<std::future<void>> pending;
+    for(const BlockInfo &info : infos)
+        pending.push_back(pool.submit([&decodeBlock, info] { decodeBlock(info, 0); }));
+    for(auto &f : pending) f.get();
+    return total;
+}
+
+std::vector<uint8_t> LZ4Frame::decompress(const std::vector<uint8_t> &frame, size_t threads, const LZ4Dictionary *dictionary)
+{
+    std::vector<uint8_t> output(decompressedSize(frame.data(), frame.size()));
+    decompress(frame.data(), frame.size(), output.data(), output.size(), threads, dictionary);
+    return output;
+}
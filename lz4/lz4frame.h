@@ -0,0 +1,116 @@
+#ifndef LZ4FRAME_H
+#define LZ4FRAME_H
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "lz4.h"
+#include "lz4dict.h"
+
+// Framed container made of independently compressed blocks:
+//   magic (u32) | version (u8) | flags (u8) | blockSize (u32)
+//   [contentSize (u64), if FLAG_CONTENT_SIZE] [dictId (u32), if FLAG_DICT_ID]
+//   { compressedSize (u32) | rawSize (u32) | block data }*
+//   end mark (u32 0)
+//   [seek table, if FLAG_SEEK_TABLE:
+//    { compressedSize (u32) | rawSize (u32) }* | blockCount (u32) | SEEK_MAGIC (u32)]
+// All integers are little-endian. By default blocks share no history, so they
+// can be compressed and decompressed in parallel while the output stays
+// identical for any thread count. With FLAG_LINKED_BLOCKS (written by
+// LZ4StreamEncoder) matches may reach up to 64KB into earlier blocks, and the
+// frame has to be decoded sequentially. With FLAG_DICT_ID every block was
+// compressed against the preset dictionary with that ID. The optional seek
+// table repeats the block sizes at the end of the frame, so a reader can find
+// the blocks covering a byte range without walking every block header.
+// With FLAG_ENTROPY each block's data is an LZ4 block passed through
+// LZ4Entropy, which Huffman-codes its literals, tokens, lengths and offsets
+// as separate streams. A block whose compressedSize has BLOCK_STORED set
+// holds its rawSize bytes as they are (in the seek table too); encoders
+// store every block that would not get smaller, and decoders copy it.
+class LZ4Frame
+{
+public:
+    static constexpr uint32_t MAGIC = 0x345A4C53; // "SLZ4"
+    static constexpr uint8_t VERSION = 1;
+    static constexpr uint8_t FLAG_LINKED_BLOCKS = 0x01;
+    static constexpr uint8_t FLAG_CONTENT_SIZE = 0x02;
+    static constexpr uint8_t FLAG_DICT_ID = 0x04;
+    static constexpr uint8_t FLAG_SEEK_TABLE = 0x08;
+    static constexpr uint8_t FLAG_ENTROPY = 0x10;
+    static constexpr uint32_t BLOCK_STORED = 0x80000000u; // in compressedSize
+    static constexpr uint32_t SEEK_MAGIC = 0x545A4C53; // "SLZT"
+    static constexpr size_t HEADER_SIZE = 10; // without optional fields
+    static constexpr size_t DEFAULT_BLOCK_SIZE = 1 << 20; // 1MB
+    static constexpr size_t MAX_BLOCK_SIZE = 1 << 26;     // 64MB
+
+    struct Options
+    {
+        size_t threads = 0; // 0 = one per hardware thread
+        size_t blockSize = DEFAULT_BLOCK_SIZE;
+        SimpleLZ4::Level level = SimpleLZ4::Level::Fast;
+        SimpleLZ4::Profile profile = SimpleLZ4::Profile::Default;
+        const LZ4Dictionary *dictionary = nullptr;
+        bool seekTable = false;
+        bool entropy = false;      // Huffman-code each block's streams (FLAG_ENTROPY)
+        LZ4Stats *stats = nullptr; // encoder counters, summed over all blocks
+    };
+
+    struct Header
+    {
+        uint8_t flags = 0;
+        size_t blockSize = DEFAULT_BLOCK_SIZE;
+        uint64_t contentSize = 0; // valid with FLAG_CONTENT_SIZE
+        uint32_t dictId = 0;      // valid with FLAG_DICT_ID
+    };
+
+    // Largest frame compress() can produce for srcSize bytes.
+    static size_t compressBound(size_t srcSize, const Options &options);
+    // Writes a whole frame into dst, which must hold compressBound() bytes;
+    // returns the frame size.
+    static size_t compress(const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstCapacity, const Options &options);
+    // Size the frame decodes to, summed from the block headers (or the seek
+    // table). A content size in the header must agree; it is never trusted
+    // on its own, since callers size their output by the result.
+    static uint64_t decompressedSize(const uint8_t *src, size_t srcSize);
+    // Decodes the frame into dst and returns the number of bytes written.
+    // Frames with a dictionary ID need the matching dictionary.
+    static size_t decompress(const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstCapacity, size_t threads,
+                             const LZ4Dictionary *dictionary = nullptr);
+    // Decodes only the blocks covering [offset, offset + length) and writes
+    // that range to dst; returns the bytes written, fewer if the range runs
+    // past the end. Uses the seek table when present. Linked frames are not
+    // seekable.
+    static size_t decompressRange(const uint8_t *src, size_t srcSize, uint64_t offset, size_t length, uint8_t *dst,
+                                  size_t dstCapacity, size_t threads, const LZ4Dictionary *dictionary = nullptr);
+    static bool isFrame(const uint8_t *src, size_t srcSize);
+
+    static std::vector<uint8_t> compress(const std::vector<uint8_t> &input, const Options &options);
+    static std::vector<uint8_t> decompress(const std::vector<uint8_t> &frame, size_t threads, const LZ4Dictionary *dictionary = nullptr);
+    // Largest block data for rawSize input bytes under header's flags.
+    static size_t blockBound(size_t rawSize, uint8_t flags);
+    // Decodes the data of one block, undoing the entropy stage first if the
+    // flags ask for it, or copies it if the block was stored; arguments as
+    // for SimpleLZ4::decompressBlock.
+    static size_t decompressBlock(uint8_t flags, bool stored, const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstCapacity,
+                                  size_t prefixLen = 0, const uint8_t *extDict = nullptr, size_t extDictSize = 0);
+    // Writes the data of one block to dst, which must hold blockBound(rawSize,
+    // flags) bytes: LZ4, then the entropy stage if the flags ask for it.
+    // Returns the block's compressedSize word, with BLOCK_STORED set if the
+    // block did not shrink and was copied instead.
+    static uint32_t compressBlock(SimpleLZ4 &codec, LZ4Context &ctx, uint8_t flags, const uint8_t *src, size_t rawSize, uint8_t *dst,
+                                  size_t prefixLen = 0, const LZ4Dictionary *dictionary = nullptr);
+    // Throws unless dictionary is the one the header asks for.
+    static void checkDictionary(const Header &header, const LZ4Dictionary *dictionary);
+    static bool isFrame(const std::vector<uint8_t> &data);
+
+    static void writeHeader(std::vector<uint8_t> &out, const Header &header);
+    // Parses the header in the first avail bytes of p. Returns its length, or
+    // 0 if more bytes are needed. Throws on an invalid header.
+    static size_t readHeader(const uint8_t *p, size_t avail, Header &header);
+
+    static void putU32(std::vector<uint8_t> &out, uint32_t v);
+    static void putU64(std::vector<uint8_t> &out, uint64_t v);
+    static void writeU32(uint8_t *p, uint32_t v);
+    static uint32_t readU32(const uint8_t *p);
+    static uint64_t readU64(const uint8_t *p);
+};
+#endif
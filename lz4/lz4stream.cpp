@@ -0,0 +1,165 @@
+#include "lz4stream.h"
+#include "lz4frame.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+static size_t drain(std::vector<uint8_t> &pending, size_t &pendingPos, uint8_t *dst, size_t cap)
+{
+    size_t n = std::min(cap, pending.size() - pendingPos);
+    if(n) std::memcpy(dst, pending.data() + pendingPos, n);
+    pendingPos += n;
+    if(pendingPos == pending.size())
+    {
+        pending.clear();
+        pendingPos = 0;
+    }
+    return n;
+}
+
+static void keepHistory(std::vector<uint8_t> &window)
+{
+    if(window.size() > SimpleLZ4::WINDOW_SIZE)
+        window.erase(window.begin(), window.end() - SimpleLZ4::WINDOW_SIZE);
+}
+
+// ---------- Encoder ----------
+
+LZ4StreamEncoder::LZ4StreamEncoder(SimpleLZ4::Level level, size_t blockSize, const LZ4Dictionary *dictionary, bool entropy,
+                                   SimpleLZ4::Profile profile)
+    : codec(level, profile), blockSize(blockSize), entropy(entropy)
+{
+    LZ4Frame::Header header;
+    header.flags = LZ4Frame::FLAG_LINKED_BLOCKS;
+    if(entropy) header.flags |= LZ4Frame::FLAG_ENTROPY;
+    header.blockSize = blockSize;
+    window.reserve(SimpleLZ4::WINDOW_SIZE + blockSize);
+    if(dictionary)
+    {
+        header.flags |= LZ4Frame::FLAG_DICT_ID;
+        header.dictId = dictionary->id();
+        window.assign(dictionary->data(), dictionary->data() + dictionary->size());
+        historyLen = window.size();
+    }
+    LZ4Frame::writeHeader(pending, header);
+}
+
+void LZ4StreamEncoder::push(const uint8_t *data, size_t len)
+{
+    if(done) throw std::runtime_error("Stream already finished.");
+    while(len > 0)
+    {
+        size_t take = std::min(len, blockSize - (window.size() - historyLen));
+        window.insert(window.end(), data, data + take);
+        data += take;
+        len -= take;
+        if(window.size() - historyLen == blockSize) flushBlock();
+    }
+}
+
+void LZ4StreamEncoder::flushBlock()
+{
+    size_t rawSize = window.size() - historyLen;
+    if(rawSize == 0) return;
+    // Compress straight into the output queue behind a block header.
+    uint8_t flags = entropy ? LZ4Frame::FLAG_ENTROPY : 0;
+    size_t headerPos = pending.size();
+    pending.resize(headerPos + 8 + LZ4Frame::blockBound(rawSize, flags));
+    uint32_t compressedSize = LZ4Frame::compressBlock(codec, context, flags, window.data() + historyLen, rawSize,
+                                                      pending.data() + headerPos + 8, historyLen);
+    LZ4Frame::writeU32(pending.data() + headerPos, compressedSize);
+    LZ4Frame::writeU32(pending.data() + headerPos + 4, static_cast<uint32_t>(rawSize));
+    pending.resize(headerPos + 8 + (compressedSize & ~LZ4Frame::BLOCK_STORED));
+    keepHistory(window);
+    historyLen = window.size();
+}
+
+void LZ4StreamEncoder::finish()
+{
+    if(done) return;
+    flushBlock();
+    LZ4Frame::putU32(pending, 0); // end mark
+    done = true;
+}
+
+size_t LZ4StreamEncoder::pull(uint8_t *dst, size_t cap)
+{
+    return drain(pending, pendingPos, dst, cap);
+}
+
+// ---------- Decoder ----------
+
+void LZ4StreamDecoder::push(const uint8_t *data, size_t len)
+{
+    input.insert(input.end(), data, data + len);
+    parse();
+    input.erase(input.begin(), input.begin() + inputPos);
+    inputPos = 0;
+}
+
+void LZ4StreamDecoder::parse()
+{
+    while(true)
+    {
+        size_t avail = input.size() - inputPos;
+        const uint8_t *p = input.data() + inputPos;
+        if(done)
+        {
+            // A seek table may follow the end mark; sequential decoding skips it.
+            if(header.flags & LZ4Frame::FLAG_SEEK_TABLE) inputPos += avail;
+            else if(avail > 0) throw std::runtime_error("Trailing data after end of frame.");
+            return;
+        }
+        if(!headerRead)
+        {
+            size_t len = LZ4Frame::readHeader(p, avail, header);
+            if(len == 0) return;
+            LZ4Frame::checkDictionary(header, dictionary);
+            // In a linked frame the dictionary is simply the history before
+            // the first block; independent blocks each get it as extDict.
+            if((header.flags & LZ4Frame::FLAG_DICT_ID) && (header.flags & LZ4Frame::FLAG_LINKED_BLOCKS))
+                window.assign(dictionary->data(), dictionary->data() + dictionary->size());
+            headerRead = true;
+            inputPos += len;
+            continue;
+        }
+
+        if(avail < 4) return;
+        uint32_t word = LZ4Frame::readU32(p);
+        if(word == 0)
+        {
+            if((header.flags & LZ4Frame::FLAG_CONTENT_SIZE) && decodedTotal != header.contentSize)
+                throw std::runtime_error("Frame content size mismatch.");
+            done = true;
+            inputPos += 4;
+            continue;
+        }
+        // Worst case is one literal run, plus the entropy stage's mode byte.
+        size_t compressedSize = word & ~LZ4Frame::BLOCK_STORED;
+        if(compressedSize > LZ4Frame::blockBound(header.blockSize, header.flags)) throw std::runtime_error("Compressed block too large.");
+        if(avail < 8 + compressedSize) return;
+        uint32_t rawSize = LZ4Frame::readU32(p + 4);
+        if(rawSize > header.blockSize) throw std::runtime_error("Block larger than frame block size.");
+
+        // Only linked blocks may reach into earlier output; an independent
+        // block sees nothing but the dictionary, if the frame has one.
+        bool linked = header.flags & LZ4Frame::FLAG_LINKED_BLOCKS;
+        if(!linked) window.clear();
+        const uint8_t *extDict = !linked && (header.flags & LZ4Frame::FLAG_DICT_ID) ? dictionary->data() : nullptr;
+        size_t extDictSize = extDict ? dictionary->size() : 0;
+        size_t historyLen = window.size();
+        window.resize(historyLen + rawSize);
+        size_t written = LZ4Frame::decompressBlock(header.flags, (word & LZ4Frame::BLOCK_STORED) != 0, p + 8, compressedSize,
+                                                   window.data() + historyLen, rawSize, historyLen, extDict, extDictSize);
+        if(written != rawSize) throw std::runtime_error("Block size mismatch during decompression.");
+        pending.insert(pending.end(), window.begin() + historyLen, window.end());
+        decodedTotal += rawSize;
+        keepHistory(window);
+        inputPos += 8 + compressedSize;
+    }
+}
+
+size_t LZ4StreamDecoder::pull(uint8_t *dst, size_t cap)
+{
+    return drain(pending, pendingPos, dst, cap);
+}
@@ -0,0 +1,77 @@
+#ifndef LZ4STREAM_H
+#define LZ4STREAM_H
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "lz4.h"
+#include "lz4frame.h"
+
+// Incremental frame encoder: push input as it arrives, pull encoded bytes as
+// they become ready. Blocks are linked (FLAG_LINKED_BLOCKS) so matches reach
+// back into the previous 64KB, and memory stays bounded by the window plus one
+// block no matter how much data passes through.
+class LZ4StreamEncoder
+{
+public:
+    static constexpr size_t DEFAULT_BLOCK_SIZE = 1 << 16; // 64KB
+
+    // A dictionary, if given, is the history before the first block and must
+    // outlive the encoder. entropy adds the LZ4Entropy stage to every block.
+    explicit LZ4StreamEncoder(SimpleLZ4::Level level = SimpleLZ4::Level::Fast, size_t blockSize = DEFAULT_BLOCK_SIZE,
+                              const LZ4Dictionary *dictionary = nullptr, bool entropy = false,
+                              SimpleLZ4::Profile profile = SimpleLZ4::Profile::Default);
+
+    // Collects encoder counters for every block compressed from now on.
+    void setStats(LZ4Stats *stats) { codec.setStats(stats); }
+
+    void push(const uint8_t *data, size_t len);
+    // Flushes the last partial block and writes the end mark.
+    void finish();
+
+    size_t available() const { return pending.size() - pendingPos; }
+    size_t pull(uint8_t *dst, size_t cap);
+
+private:
+    void flushBlock();
+
+    SimpleLZ4 codec;
+    LZ4Context context;
+    size_t blockSize;
+    bool entropy;
+    std::vector<uint8_t> window; // history (<= 64KB) followed by the block being filled
+    size_t historyLen = 0;
+    std::vector<uint8_t> pending;
+    size_t pendingPos = 0;
+    bool done = false;
+};
+
+// Incremental frame decoder. Accepts linked and independent frames; only the
+// 64KB history window and one compressed block are buffered.
+class LZ4StreamDecoder
+{
+public:
+    // Needed (and must outlive the decoder) for frames with a dictionary ID.
+    explicit LZ4StreamDecoder(const LZ4Dictionary *dictionary = nullptr) : dictionary(dictionary) {}
+
+    void push(const uint8_t *data, size_t len);
+    // True once the end mark has been decoded.
+    bool finished() const { return done; }
+
+    size_t available() const { return pending.size() - pendingPos; }
+    size_t pull(uint8_t *dst, size_t cap);
+
+private:
+    void parse();
+
+    std::vector<uint8_t> input;
+    size_t inputPos = 0;
+    std::vector<uint8_t> window; // decoded history of a linked frame, at most 64KB between blocks
+    std::vector<uint8_t> pending;
+    size_t pendingPos = 0;
+    const LZ4Dictionary *dictionary;
+    LZ4Frame::Header header;
+    uint64_t decodedTotal = 0;
+    bool headerRead = false;
+    bool done = false;
+};
+#endif
@@ -1,68 +1,292 @@
+#include <algorithm>
 #include <chrono>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <memory>
 #include "lz4.h"
+#include "lz4archive.h"
+#include "lz4dict.h"
+#include "lz4frame.h"
+#include "lz4stream.h"
+#include "../common/mapped_file.h"
+#include <string>
 #include <vector>
+#include <unistd.h>
 
 constexpr size_t CHUNK_SIZE = 1<<20; // 1MB
 
-std::vector<uint8_t> readFile(const std::string &path)
+std::istream &openInput(const std::string &path, std::ifstream &file)
 {
-    std::ifstream in(path, std::ios::binary | std::ios::ate);
-    if(!in) throw std::runtime_error("Cannot open file : " + path);
-    std::streamsize size = in.tellg();
-    in.seekg(0, std::ios::beg);
-    std::vector<uint8_t> buffer(size);
-    if(!in.read(reinterpret_cast<char*> (buffer.data()), size)) {
-        throw std::runtime_error("Cannot read file : " + path);
-    }
-    return buffer;
+    if (path == "-") return std::cin;
+    file.open(path, std::ios::binary);
+    if (!file) throw std::runtime_error("Cannot open file : " + path);
+    return file;
 }
 
-void writeFile(const std::string &path, const std::vector<uint8_t> &data)
+std::ostream &openOutput(const std::string &path, std::ofstream &file)
 {
-    std::ofstream file(path, std::ios::binary);
+    if (path == "-") return std::cout;
+    file.open(path, std::ios::binary);
     if (!file) throw std::runtime_error("Cannot open file: " + path);
-    if (!file.write(reinterpret_cast<const char*>(data.data()), data.size())) {
-        throw std::runtime_error("Failed to write file: " + path);
+    return file;
+}
+
+template <typename Stream>
+void drainTo(Stream &stream, std::ostream &out)
+{
+    uint8_t buf[CHUNK_SIZE / 16];
+    while (size_t n = stream.pull(buf, sizeof(buf))) {
+        if (!out.write(reinterpret_cast<const char*>(buf), n))
+            throw std::runtime_error("Failed to write output.");
+    }
+}
+
+// Feeds the whole input through an encoder or decoder one chunk at a time,
+// so memory use does not depend on the input size.
+template <typename Stream>
+void pump(Stream &stream, std::istream &in, std::ostream &out)
+{
+    std::vector<uint8_t> chunk(CHUNK_SIZE / 16);
+    while (in) {
+        in.read(reinterpret_cast<char*>(chunk.data()), chunk.size());
+        size_t readBytes = in.gcount();
+        if (readBytes == 0) break;
+        stream.push(chunk.data(), readBytes);
+        drainTo(stream, out);
+    }
+    if (in.bad()) throw std::runtime_error("Failed to read input.");
+}
+
+// archive <dir> <archive>, extract <archive> <dir> [name...], list <archive>.
+int archiveMain(const std::vector<std::string> &args, LZ4Frame::Options options, const std::string &dictPath, bool printStats)
+{
+    const std::string &mode = args[0];
+    if ((mode == "list" && args.size() != 2) || (mode == "archive" && args.size() != 3) || (mode == "extract" && args.size() < 3)) {
+        std::cerr << "Usage: lz4 [-T threads] [--level fast|high] [--profile default|small|large] [-D dictionary] [--entropy] [--stats] archive <directory> <archive>\n"
+                  << "       lz4 [-T threads] [-D dictionary] extract <archive> <directory> [name...]\n"
+                  << "       lz4 list <archive>\n";
+        return 1;
+    }
+    if (printStats && mode != "archive") {
+        std::cerr << "--stats only applies to archive\n";
+        return 1;
+    }
+    LZ4Stats stats;
+    if (printStats) options.stats = &stats;
+
+    try
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::unique_ptr<LZ4Dictionary> dictionary;
+        if (!dictPath.empty()) {
+            dictionary.reset(new LZ4Dictionary(LZ4Dictionary::load(dictPath)));
+            options.dictionary = dictionary.get();
+        }
+        if (mode == "list") {
+            MappedFile in = MappedFile::openRead(args[1]);
+            LZ4Archive::Index index = LZ4Archive::readIndex(in.data(), in.size());
+            uint64_t total = 0;
+            for (const LZ4Archive::Entry &entry : index.entries) {
+                std::cout << std::setw(12) << entry.size << "  " << entry.name << '\n';
+                total += entry.size;
+            }
+            std::cout << std::setw(12) << total << "  " << index.entries.size() << " files in " << index.blocks.size() << " blocks\n";
+            return 0;
+        }
+        size_t files = mode == "archive"
+            ? LZ4Archive::create(args[1], args[2], options)
+            : LZ4Archive::extract(args[1], args[2], std::vector<std::string>(args.begin() + 3, args.end()), options.threads,
+                                  options.dictionary);
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+        std::cout << mode << (mode == "archive" ? "d " : "ed ") << files << " files in " << ms << " ms\n";
+        if (printStats) stats.print(std::cout);
     }
+    catch(const std::exception &e)
+    {
+        std::cerr << "Error : " << e.what() << '\n';
+        return 1;
+    }
+    return 0;
 }
 
 int main(int argc, char*argv[])
 {
-    if (argc != 4) {
-        std::cerr << "Usage: lz4 <compress|decompress> <input_file> <output_file>\n";
+    bool streaming = false;
+    bool printStats = false;
+    LZ4Stats stats;
+    std::string dictPath;
+    bool ranged = false;
+    uint64_t rangeOffset = 0;
+    size_t rangeLength = 0;
+    LZ4Frame::Options options;
+    options.blockSize = CHUNK_SIZE;
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("-T", 0) == 0) {
+            std::string value = arg.size() > 2 ? arg.substr(2) : (i + 1 < argc ? argv[++i] : "");
+            try {
+                options.threads = std::stoul(value);
+            } catch (const std::exception &) {
+                std::cerr << "Invalid thread count: " << value << '\n';
+                return 1;
+            }
+        } else if (arg == "--level") {
+            std::string value = i + 1 < argc ? argv[++i] : "";
+            if (value == "fast") {
+                options.level = SimpleLZ4::Level::Fast;
+            } else if (value == "high") {
+                options.level = SimpleLZ4::Level::High;
+            } else {
+                std::cerr << "Invalid level: choose 'fast' or 'high'\n";
+                return 1;
+            }
+        } else if (arg == "--profile") {
+            std::string value = i + 1 < argc ? argv[++i] : "";
+            if (value == "default") {
+                options.profile = SimpleLZ4::Profile::Default;
+            } else if (value == "small") {
+                options.profile = SimpleLZ4::Profile::Small;
+            } else if (value == "large") {
+                options.profile = SimpleLZ4::Profile::Large;
+            } else {
+                std::cerr << "Invalid profile: choose 'default', 'small' or 'large'\n";
+                return 1;
+            }
+        } else if (arg == "-D") {
+            dictPath = i + 1 < argc ? argv[++i] : "";
+        } else if (arg == "--entropy") {
+            options.entropy = true;
+        } else if (arg == "--seekable") {
+            options.seekTable = true;
+        } else if (arg == "--range") {
+            std::string value = i + 1 < argc ? argv[++i] : "";
+            size_t colon = value.find(':');
+            try {
+                if (colon == std::string::npos) throw std::invalid_argument(value);
+                rangeOffset = std::stoull(value.substr(0, colon));
+                rangeLength = std::stoull(value.substr(colon + 1));
+            } catch (const std::exception &) {
+                std::cerr << "Invalid range: expected <offset>:<length>\n";
+                return 1;
+            }
+            ranged = true;
+        } else if (arg == "--stats") {
+            printStats = true;
+        } else if (arg == "--stream") {
+            streaming = true;
+        } else {
+            args.push_back(arg);
+        }
+    }
+    if (!args.empty() && (args[0] == "archive" || args[0] == "extract" || args[0] == "list")) {
+        if (streaming || ranged || options.seekTable) {
+            std::cerr << "--stream, --seekable and --range do not apply to archives\n";
+            return 1;
+        }
+        return archiveMain(args, options, dictPath, printStats);
+    }
+    if (args.size() != 3) {
+        std::cerr << "Usage: lz4 [-T threads] [--level fast|high] [--profile default|small|large] [-D dictionary] [--stream] [--entropy] [--seekable] [--range off:len] [--stats] <compress|decompress> <input_file|-> <output_file|->\n"
+                  << "       lz4 [options] archive <directory> <archive> | extract <archive> <directory> [name...] | list <archive>\n";
+        return 1;
+    }
+    std::string mode = args[0];
+    std::string inputFile = args[1];
+    std::string outputFile = args[2];
+    if (mode != "compress" && mode != "decompress") {
+        std::cerr << "Invalid mode: choose 'compress' or 'decompress'\n";
         return 1;
     }
-    std::string mode = argv[1];
-    std::string inputFile = argv[2];
-    std::string outputFile = argv[3];
+    if (ranged && mode != "decompress") {
+        std::cerr << "--range only applies to decompress\n";
+        return 1;
+    }
+    if (printStats && mode != "compress") {
+        std::cerr << "--stats only applies to compress\n";
+        return 1;
+    }
+    if (printStats) options.stats = &stats;
+    // Pipes have no size to read up front, so they always stream.
+    if (inputFile == "-" || outputFile == "-") streaming = true;
+    std::ostream &report = (outputFile == "-") ? std::cerr : std::cout;
+    // Set just before the output file is opened, so a failed run removes
+    // what it wrote but never a file it did not get to.
+    bool outputTouched = false;
+    auto createOutput = [&](size_t size) {
+        outputTouched = true;
+        return MappedFile::create(outputFile, size);
+    };
 
-    SimpleLZ4 codec;
     try
     {
         auto start = std::chrono::steady_clock::now();
-        std::vector<uint8_t> inputData = readFile(inputFile);
-        std::vector<uint8_t> outputData;
+        std::unique_ptr<LZ4Dictionary> dictionary;
+        if (!dictPath.empty()) {
+            dictionary.reset(new LZ4Dictionary(LZ4Dictionary::load(dictPath)));
+            options.dictionary = dictionary.get();
+        }
+        if (streaming && ranged) {
+            throw std::runtime_error("--range needs a seekable input file, not a stream.");
+        }
+        if (streaming) {
+            std::ifstream inFile;
+            std::ofstream outFile;
+            std::istream &in = openInput(inputFile, inFile);
+            outputTouched = outputFile != "-";
+            std::ostream &out = openOutput(outputFile, outFile);
+            if (mode == "compress") {
+                LZ4StreamEncoder encoder(options.level, LZ4StreamEncoder::DEFAULT_BLOCK_SIZE, options.dictionary, options.entropy,
+                                         options.profile);
+                encoder.setStats(options.stats);
+                pump(encoder, in, out);
+                encoder.finish();
+                drainTo(encoder, out);
+            } else {
+                LZ4StreamDecoder decoder(options.dictionary);
+                pump(decoder, in, out);
+                if (!decoder.finished()) throw std::runtime_error("Truncated frame.");
+            }
+            if (!out.flush()) throw std::runtime_error("Failed to write output.");
+            auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+            report << mode << "ion completed in " << ms << " ms\n";
+            if (printStats) stats.print(report);
+            return 0;
+        }
 
+        // Map the input and write the result straight into a preallocated
+        // output mapping, so neither side is copied through stream buffers.
+        MappedFile in = MappedFile::openRead(inputFile);
         if (mode == "compress") {
-            outputData = codec.compress(inputData);
-        } else if (mode == "decompress") {
-            outputData = codec.decompress(inputData);
+            MappedFile out = createOutput(LZ4Frame::compressBound(in.size(), options));
+            out.resize(LZ4Frame::compress(in.data(), in.size(), out.data(), out.size(), options));
+        } else if (ranged) {
+            // Only the blocks overlapping the range are decoded.
+            uint64_t total = LZ4Frame::decompressedSize(in.data(), in.size());
+            uint64_t available = rangeOffset < total ? total - rangeOffset : 0;
+            MappedFile out = createOutput(static_cast<size_t>(std::min<uint64_t>(rangeLength, available)));
+            out.resize(LZ4Frame::decompressRange(in.data(), in.size(), rangeOffset, rangeLength, out.data(), out.size(),
+                                                 options.threads, options.dictionary));
+        } else if (LZ4Frame::isFrame(in.data(), in.size())) {
+            MappedFile out = createOutput(LZ4Frame::decompressedSize(in.data(), in.size()));
+            LZ4Frame::decompress(in.data(), in.size(), out.data(), out.size(), options.threads, options.dictionary);
         } else {
-            std::cerr << "Invalid mode: choose 'compress' or 'decompress'\n";
-            return 1;
+            // Files written before the framed format are a single raw block.
+            MappedFile out = createOutput(SimpleLZ4::decodedSize(in.data(), in.size()));
+            SimpleLZ4::decompressBlock(in.data(), in.size(), out.data(), out.size());
         }
 
-        writeFile(outputFile, outputData);
         auto end = std::chrono::steady_clock::now();
         auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
 
-        std::cout << mode << "ion completed in " << ms << " ms\n";
+        report << mode << "ion completed in " << ms << " ms\n";
+        if (printStats) stats.print(report);
     }
     catch(const std::exception &e)
     {
         std::cerr << "Error : " << e.what() << '\n';
+        if (outputTouched) ::unlink(outputFile.c_str());
         return 1;
     }
 